@@ -57,14 +57,23 @@
 #define UTIL_WEIGHT .60
 
 /*
- * Alignment requirement in bytes (either 4 or 8)
+ * Alignment requirement in bytes (8, or 16 for the -DALIGN16 build)
  */
+#ifdef ALIGN16
+#define ALIGNMENT 16
+#else
 #define ALIGNMENT 8
+#endif
 
 /*
- * Maximum heap size in bytes
+ * Maximum heap size in bytes. The 64-bit tag build (-DWIDE) gets room
+ * for blocks beyond 4 GB; memlib only reserves the address space.
  */
+#ifdef WIDE
+#define MAX_HEAP ((size_t)16 << 30)  /* 16 GB */
+#else
 #define MAX_HEAP (20*(1<<20))  /* 20 MB */
+#endif
 
 #define AUTOGRADE_TIMEOUT 360
 
@@ -8,6 +8,7 @@
  * May not be used, modified, or copied without permission.
  */
 #include <assert.h>
+#include <dlfcn.h>
 #include <errno.h>
 #include <float.h>
 #include <setjmp.h>
@@ -18,6 +19,9 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#ifdef THREAD_SAFE
+#include <pthread.h>
+#endif
 
 #ifndef __GCC__
 #  define __attribute__(args)
@@ -37,8 +41,8 @@
 #define HDRLINES       4 /* number of header lines in a trace file */
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
 
-/* Returns true if p is ALIGNMENT-byte aligned */
-#define IS_ALIGNED(p)  ((((unsigned long)(p)) % ALIGNMENT) == 0)
+/* Returns true if p is align-byte aligned */
+#define IS_ALIGNED(p, align)  ((((unsigned long)(p)) % (align)) == 0)
 
 /******************************
  * The key compound data types
@@ -61,9 +65,12 @@ typedef struct range_t {
 
 /* Characterizes a single trace operation (allocator request) */
 typedef struct {
-	enum { ALLOC, FREE, REALLOC } type; /* type of request */
+	enum { ALLOC, FREE, REALLOC, CALLOC, MEMALIGN,
+		BATCH_ALLOC, BATCH_FREE } type; /* type of request */
 	int index;                        /* index for free() to use later */
-	size_t size;                      /* byte size of alloc/realloc request */
+	size_t size;                      /* byte size of alloc/realloc/calloc/memalign request */
+	size_t align;                     /* alignment the payload needs */
+	int count;                        /* blocks index..index+count-1 of a batch */
 } traceop_t;
 
 /* Holds the information for one trace file*/
@@ -77,6 +84,7 @@ typedef struct {
 	char **blocks;       /* array of ptrs returned by malloc/realloc... */
 	size_t *block_sizes; /* ... and a corresponding array of payload sizes */
 	int *block_rand_base;/* index into random_data, if debug is on */
+	void **batch;        /* room for the pointers of the largest batch */
 } trace_t;
 
 /*
@@ -87,8 +95,45 @@ typedef struct {
 typedef struct {
 	trace_t *trace;
 	range_t *ranges;
+	const char *in_arena;  /* requests served by an arena (-E) */
+	int epoch;             /* requests between arena resets (-E) */
 } speed_t;
 
+/* Parameters and results of one run of the node-churn benchmark (-P) */
+typedef struct {
+	size_t size;      /* node size */
+	int pool;         /* use an mm_pool_t rather than mm_malloc */
+	int ops;          /* allocations and frees made */
+	int garbled;      /* nodes whose tag was overwritten */
+	size_t released;  /* chunks mm_pool_release gave back */
+} churn_t;
+
+/* Parameters and results of one run of the large-block churn benchmark (-L) */
+typedef struct {
+	int count;        /* blocks freed and allocated again */
+	int tree;         /* M_TREE setting */
+	int ops;          /* allocations and frees made */
+	int garbled;      /* blocks whose tag was overwritten */
+} large_t;
+
+/* One mm malloc package: the mm.c linked in, or a shared object (-b) */
+typedef struct {
+	const char *name;
+	void *handle;     /* from dlopen, NULL for the linked package */
+	int (*init)(void);
+	void *(*malloc)(size_t size);
+	void (*free)(void *ptr);
+	void *(*realloc)(void *ptr, size_t size);
+	void *(*calloc)(size_t nmemb, size_t size);
+	void *(*memalign)(size_t alignment, size_t size);     /* may be NULL */
+	void (*free_sized)(void *ptr, size_t size);
+	size_t (*malloc_batch)(size_t size, size_t n, void **out);
+	void (*free_batch)(void **ptrs, size_t n);
+	size_t (*usable_size)(void *ptr);                     /* may be NULL */
+	size_t (*good_size)(size_t size);
+	void (*checkheap)(int verbose);
+} backend_t;
+
 /* Summarizes the important stats for some malloc function on some trace */
 typedef struct {
 	/* set in read_trace */
@@ -102,6 +147,11 @@ typedef struct {
 
 	/* defined only for the student malloc package */
 	double util;     /* space utilization for this trace (always 0 for libc) */
+	mm_stats_t counters; /* mm_get_stats() after the correctness run */
+	size_t peak_heap;    /* most heap and mapped bytes at once (-M) */
+	size_t end_heap;     /* heap and mapped bytes at the end of the correctness run (-M) */
+	size_t resident;     /* of those, bytes resident in memory (-M) */
+	size_t trimmed;      /* bytes still resident after mm_trim(0) (-M) */
 
 	/* Note: secs and util are only defined if valid is true */
 } stats_t;
@@ -157,6 +207,22 @@ int verbose = 1;        /* global flag for verbose output */
 static int errors = 0;  /* number of errs found when running student malloc */
 int onetime_flag = 0;
 
+/* -B runs the batch requests one block at a time first; COMPARE_BATCH
+   stands in for an mm_mallopt knob in compare_param */
+#define COMPARE_BATCH (-1)
+static int split_batches = 0;
+
+/* -M samples resident memory and trims the heap after each correctness run */
+static int resident_report = 0;
+
+/* The package the trace replays go through: mm.c unless -b loads others */
+static backend_t linked_mm = {
+	"mm", NULL, mm_init, mm_malloc, mm_free, mm_realloc, mm_calloc,
+	mm_memalign, mm_free_sized, mm_malloc_batch, mm_free_batch,
+	mm_usable_size, mm_good_size, mm_checkheap
+};
+static backend_t *backend = &linked_mm;
+
 /* by default, no timeouts */
 static int set_timeout = 0;
 
@@ -174,9 +240,11 @@ static char *default_tracefiles[] = {
  *********************/
 
 /* these functions manipulate range lists */
-static int add_range(range_t **ranges, char *lo, int size,
+static int add_range(range_t **ranges, char *lo, size_t size, size_t align,
 		const trace_t *trace, int opnum, int index);
 static void remove_range(range_t **ranges, char *lo);
+static int check_usable(range_t **ranges, char *lo, size_t size,
+		size_t align, const trace_t *trace, int opnum);
 static void clear_ranges(range_t **ranges);
 
 /* These functions implement the debugging code */
@@ -184,6 +252,10 @@ static void init_random_data(void);
 static void check_index(const trace_t *trace, int opnum, int index);
 static void randomize_block(trace_t *trace, int index);
 
+/* these functions run the batch requests */
+static int batch_alloc(const traceop_t *op, char **blocks);
+static void batch_free(const traceop_t *op, char **blocks, void **batch);
+
 /* These functions read, allocate, and free storage for traces */
 static trace_t *read_trace(stats_t *stats, const char *tracedir,
 		const char *filename);
@@ -200,8 +272,50 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges);
 static double eval_mm_util(trace_t *trace, int tracenum);
 static void eval_mm_speed(void *ptr);
 
+#ifdef THREAD_SAFE
+/* Routines for measuring how mm malloc scales with the number of threads */
+static void eval_mm_threads(trace_t *trace, int maxthreads, int heaps);
+static void *thread_replay(void *ptr);
+#endif
+
+/* Routines for replaying a trace partly inside arenas (-E) */
+static int arena_plan(const trace_t *trace, int epoch, char *in_arena);
+static int arena_check(const trace_t *trace, int index);
+static int arena_replay(trace_t *trace, const char *in_arena, int epoch,
+		int check);
+static void eval_mm_arena_speed(void *ptr);
+static void eval_mm_arena(trace_t *trace, int epoch);
+
+/* The node-churn benchmark for mm_pool_t (-P) */
+static char *churn_new(churn_t *c, mm_pool_t *pool, int k);
+static void churn_free(churn_t *c, mm_pool_t *pool, char *p, int k);
+static void eval_churn(void *ptr);
+static void eval_mm_churn(void);
+
+/* The large-block churn benchmark for the size tree (-L) */
+static char *large_new(large_t *l, int k);
+static void eval_large(void *ptr);
+static void eval_mm_large(void);
+
+/* Loading mm packages from shared objects and comparing them (-b) */
+static backend_t *load_backend(const char *path);
+static void *any_calloc(size_t nmemb, size_t size);
+static void any_free_sized(void *ptr, size_t size);
+static size_t any_malloc_batch(size_t size, size_t n, void **out);
+static void any_free_batch(void **ptrs, size_t n);
+static size_t any_good_size(size_t size);
+static void any_checkheap(int verbose);
+static void eval_backends(int n, const char *tracedir, char **tracefiles,
+		char *list);
+static void printbackends(int n, int nb, backend_t **backends,
+		stats_t **stats, stats_t *libc_stats);
+
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void printcompare(int n, stats_t *before, stats_t *after);
+static void printreallocs(int n, stats_t *stats);
+static void printfast(int n, stats_t *stats);
+static void printresident(int n, stats_t *stats);
 static void usage(void);
 static void malloc_error(const trace_t *trace, int opnum, const char *fmt, ...)
 	__attribute__((format(printf, 3,4)));
@@ -234,13 +348,24 @@ static void run_tests(int num_tracefiles, const char *tracedir,
 		trace_t *trace;
 		trace = read_trace(&mm_stats[i], tracedir, tracefiles[i]);
 		strcpy(mm_stats[i].filename, trace->filename);
-		mm_stats[i].ops = trace->num_ops;
 		if(timed_out) {
 			mm_stats[i].valid = 0;
 		} else {
 			if (verbose > 1)
 				printf("Checking mm_malloc for correctness, ");
+			/* start from a heap with nothing resident, for -M */
+			mem_reset_brk();
+			if (resident_report)
+				mem_purge(mem_heap_lo(), MAX_HEAP);
 			mm_stats[i].valid = eval_mm_valid(trace, &ranges);
+			mm_get_stats(&mm_stats[i].counters);
+			mm_stats[i].peak_heap = mem_peak_footprint();
+			mm_stats[i].end_heap = mem_heapsize() + mem_mapsize();
+			if (resident_report) {
+				mm_stats[i].resident = mem_resident();
+				mm_trim(0);
+				mm_stats[i].trimmed = mem_resident();
+			}
 
 			if (onetime_flag) {
 				free_trace(trace);
@@ -274,9 +399,20 @@ int main(int argc, char **argv)
 	range_t *ranges = NULL;    /* keeps track of block extents for one trace */
 	stats_t *libc_stats = NULL;/* libc stats for each trace */
 	stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
+	stats_t *base_stats = NULL; /* mm stats with compare_param off (-S, -Z, -B, -Q, -O) */
 	speed_t speed_params;      /* input parameters to the xx_speed routines */
 
 	int run_libc = 0;     /* If set, run libc malloc (set by -l) */
+	int compare_param = 0; /* If set, also run mm with this mm_mallopt knob off (-S, -Z, -B, -Q, -O) */
+	int realloc_report = 0; /* If set, print realloc copy counts (-R) */
+#ifdef THREAD_SAFE
+	int maxthreads = 0;   /* If set, run the thread-scaling mode (set by -T) */
+	int thread_heaps = 0; /* If set, give each of those threads a heap (-H) */
+#endif
+	int arena_epoch = 0;  /* If set, run the arena mode with epochs this long (-E) */
+	int churn = 0;        /* If set, run the node-churn benchmark (-P) */
+	int large = 0;        /* If set, run the large-block churn benchmark (-L) */
+	char *backend_list = NULL; /* If set, compare these shared objects (-b) */
 	int autograder = 0;   /* if set then called by autograder (-A) */
 
 	/* temporaries used to compute the performance index */
@@ -291,7 +427,7 @@ int main(int argc, char **argv)
 	/*
 	 * Read and interpret the command line arguments
 	 */
-	while ((c = getopt(argc, argv, "d:f:c:s:t:v:hVAlD")) != EOF) {
+	while ((c = getopt(argc, argv, "d:f:c:s:t:v:T:E:b:hVAlDSRZMBPHQLO")) != EOF) {
 		switch (c) {
 
 			case 'A': /* Hidden Autolab driver argument */
@@ -329,6 +465,34 @@ int main(int argc, char **argv)
 				run_libc = 1;
 				break;
 
+			case 'S': /* Compare mm with and without slab pages */
+				compare_param = M_SLAB;
+				break;
+
+			case 'Z': /* Compare mm with and without known-zero calloc */
+				compare_param = M_KNOWN_ZERO;
+				break;
+
+			case 'B': /* Compare batch requests split up and batched */
+				compare_param = COMPARE_BATCH;
+				break;
+
+			case 'Q': /* Compare mm with and without fast bins */
+				compare_param = M_FAST;
+				break;
+
+			case 'O': /* Compare mm with and without address-ordered fit */
+				compare_param = M_ADDR_FIT;
+				break;
+
+			case 'R': /* Report realloc copies made and avoided */
+				realloc_report = 1;
+				break;
+
+			case 'M': /* Report how much of the heap is resident */
+				resident_report = 1;
+				break;
+
 			case 'V': /* Increase verbosity level */
 				verbose += 1;
 				break;
@@ -349,6 +513,42 @@ int main(int argc, char **argv)
 				set_timeout = atoi(optarg);
 				break;
 
+			case 'T': /* Measure throughput with 1..n threads */
+#ifdef THREAD_SAFE
+				maxthreads = atoi(optarg);
+				if (maxthreads < 1)
+					app_error("-T needs at least one thread\n");
+				break;
+#else
+				app_error("-T needs the thread-safe build (make mdriver-mt)\n");
+#endif
+
+			case 'H': /* Give every thread of -T a heap of its own */
+#ifdef THREAD_SAFE
+				thread_heaps = 1;
+				break;
+#else
+				app_error("-H needs the thread-safe build (make mdriver-mt)\n");
+#endif
+
+			case 'E': /* Replay short-lived blocks in arenas */
+				arena_epoch = atoi(optarg);
+				if (arena_epoch < 1)
+					app_error("-E needs an epoch of at least one request\n");
+				break;
+
+			case 'P': /* Compare pools with mm_malloc on node churn */
+				churn = 1;
+				break;
+
+			case 'L': /* Compare the size tree with a list on large blocks */
+				large = 1;
+				break;
+
+			case 'b': /* Compare mm packages built as shared objects */
+				backend_list = optarg;
+				break;
+
 			case 'h': /* Print this message */
 				usage();
 				exit(0);
@@ -372,6 +572,67 @@ int main(int argc, char **argv)
 	/* Initialize the timing package */
 	init_fsecs();
 
+#ifdef THREAD_SAFE
+	/*
+	 * The thread-scaling mode replaces the usual evaluation: each trace
+	 * is replayed by 1, 2, 4, ... maxthreads threads at once.
+	 */
+	if (thread_heaps && !maxthreads)
+		app_error("-H only applies to the thread-scaling mode (-T)\n");
+	if (maxthreads) {
+		stats_t stats;
+
+		mem_init();
+		for (i = 0; i < num_tracefiles; i++) {
+			trace_t *trace = read_trace(&stats, tracedir, tracefiles[i]);
+			eval_mm_threads(trace, maxthreads, thread_heaps);
+			free_trace(trace);
+		}
+		exit(errors ? 1 : 0);
+	}
+#endif
+
+	/* So does the node-churn benchmark, which needs no traces */
+	if (churn) {
+		mem_init();
+		eval_mm_churn();
+		exit(errors ? 1 : 0);
+	}
+	if (large) {
+		mem_init();
+		eval_mm_large();
+		exit(errors ? 1 : 0);
+	}
+
+	/*
+	 * As does -b: every shared object in the list, and libc, replays
+	 * the same traces, and the results are printed side by side.
+	 */
+	if (backend_list) {
+		mem_init();
+		eval_backends(num_tracefiles, tracedir, tracefiles, backend_list);
+		exit(errors ? 1 : 0);
+	}
+
+	/*
+	 * The arena mode also replaces the usual evaluation: each trace is
+	 * timed with and without arenas for the blocks that die young.
+	 */
+	if (arena_epoch) {
+		stats_t stats;
+
+		mem_init();
+		printf("\nArenas reset every %d requests:\n", arena_epoch);
+		printf("%8s%10s%10s%11s%11s%8s  %s\n", "arena", "heap KB",
+				"arena KB", "heap Kops", "arena Kops", "ratio", "trace");
+		for (i = 0; i < num_tracefiles; i++) {
+			trace_t *trace = read_trace(&stats, tracedir, tracefiles[i]);
+			eval_mm_arena(trace, arena_epoch);
+			free_trace(trace);
+		}
+		exit(errors ? 1 : 0);
+	}
+
 	/* Initialize the timeout */
 	if (set_timeout) {
 		init_timeout(set_timeout);
@@ -427,6 +688,24 @@ int main(int argc, char **argv)
 	/* Initialize the simulated memory system in memlib.c */
 	mem_init();
 
+	/* With -S, -Z, -B, -Q or -O, first get a baseline with that feature turned off */
+	if (compare_param && !onetime_flag) {
+		base_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+		if (base_stats == NULL)
+			unix_error("base_stats calloc in main failed");
+		if (compare_param == COMPARE_BATCH)
+			split_batches = 1;
+		else if (!mm_mallopt(compare_param, 0))
+			app_error("This build has no mm_mallopt knob %d to compare\n",
+					compare_param);
+		run_tests(num_tracefiles, tracedir, tracefiles, base_stats,
+				ranges, &speed_params);
+		if (compare_param == COMPARE_BATCH)
+			split_batches = 0;
+		else
+			mm_mallopt(compare_param, 1);
+	}
+
 	run_tests(num_tracefiles, tracedir, tracefiles, mm_stats,
 			ranges, &speed_params);
 
@@ -444,6 +723,30 @@ int main(int argc, char **argv)
 			printf("\nResults for mm malloc:\n");
 			printresults(num_tracefiles, mm_stats);
 			printf("\n");
+			if (base_stats != NULL) {
+				printf("%s off -> on:\n", compare_param == M_SLAB ?
+						"Slab pages" : compare_param == M_KNOWN_ZERO ?
+						"Known-zero calloc" : compare_param == M_FAST ?
+						"Fast bins" : compare_param == M_ADDR_FIT ?
+						"Address-ordered fit" : "Batch calls");
+				printcompare(num_tracefiles, base_stats, mm_stats);
+				printf("\n");
+			}
+			if (compare_param == M_FAST) {
+				printf("Fast bins:\n");
+				printfast(num_tracefiles, mm_stats);
+				printf("\n");
+			}
+			if (realloc_report) {
+				printf("Realloc copies:\n");
+				printreallocs(num_tracefiles, mm_stats);
+				printf("\n");
+			}
+			if (resident_report) {
+				printf("Resident heap:\n");
+				printresident(num_tracefiles, mm_stats);
+				printf("\n");
+			}
 		}
 	}
 
@@ -532,10 +835,11 @@ int main(int argc, char **argv)
 /*
  * add_range - As directed by request opnum in trace tracenum,
  *     we've just called the student's mm_malloc to allocate a block of
- *     size bytes at addr lo. After checking the block for correctness,
- *     we create a range struct for this block and add it to the range list.
+ *     size bytes at addr lo, which must be align-byte aligned. After
+ *     checking the block for correctness, we create a range struct for
+ *     this block and add it to the range list.
  */
-static int add_range(range_t **ranges, char *lo, int size,
+static int add_range(range_t **ranges, char *lo, size_t size, size_t align,
 		const trace_t *trace, int opnum, int index)
 {
 	char *hi = lo + size - 1;
@@ -543,16 +847,18 @@ static int add_range(range_t **ranges, char *lo, int size,
 
 	assert(size > 0);
 
-	/* Payload addresses must be ALIGNMENT-byte aligned */
-	if (!IS_ALIGNED(lo)) {
+	/* Payload addresses must be ALIGNMENT-byte aligned, or more if asked */
+	if (!IS_ALIGNED(lo, align)) {
 		malloc_error(trace, opnum,
-				"Payload address (%p) not aligned to %d bytes", lo, ALIGNMENT);
+				"Payload address (%p) not aligned to %zu bytes", lo, align);
 		return 0;
 	}
 
-	/* The payload must lie within the extent of the heap */
-	if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
-			(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+	/* The payload must lie within the extent of the heap, or of a
+	   region mapped with mem_map */
+	if (((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
+			(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) &&
+			!mem_in_region(lo, size)) {
 		malloc_error(trace, opnum,
 				"Payload (%p:%p) lies outside heap (%p:%p)",
 				lo, hi, mem_heap_lo(), mem_heap_hi());
@@ -590,6 +896,46 @@ static int add_range(range_t **ranges, char *lo, int size,
 	return 1;
 }
 
+/*
+ * check_usable - The block of size bytes at lo was just added to the
+ *     range list. mm_usable_size must give it at least mm_good_size
+ *     bytes (just size if it was aligned to more than ALIGNMENT), which
+ *     must be at least size, and none of those bytes may overlap another
+ *     payload. The range then covers all of them.
+ */
+static int check_usable(range_t **ranges, char *lo, size_t size,
+		size_t align, const trace_t *trace, int opnum)
+{
+	size_t good, usable;
+	char *hi;
+	range_t *p;
+
+	/* a backend from -b may not say how big its blocks are */
+	if (backend->usable_size == NULL)
+		return 1;
+	good = (align > ALIGNMENT) ? size : backend->good_size(size);
+	usable = backend->usable_size(lo);
+	hi = lo + usable - 1;
+	if (good < size || usable < good) {
+		malloc_error(trace, opnum, "Payload (%p) of %zu bytes has "
+				"mm_usable_size %zu, mm_good_size %zu", lo, size, usable, good);
+		return 0;
+	}
+
+	if(trace->ignore_ranges || debug_mode == DBG_NONE) return 1;
+
+	for (p = *ranges;  p != NULL;  p = p->next) {
+		if (p->lo != lo && lo <= p->hi && hi >= p->lo) {
+			malloc_error(trace, opnum,
+					"Usable payload (%p:%p) overlaps another payload (%p:%p)\n",
+					lo, hi, p->lo, p->hi);
+			return 0;
+		}
+	}
+	(*ranges)->hi = hi;
+	return 1;
+}
+
 /*
  * remove_range - Free the range record of block whose payload starts at lo
  */
@@ -687,6 +1033,46 @@ static void check_index(const trace_t *trace, int opnum, int index) {
 	}
 }
 
+/**********************************************
+ * The following routines run the batch requests
+ *********************************************/
+
+/*
+ * batch_alloc - Allocate blocks op->index.. of a batch into blocks[]
+ *     with mm_malloc_batch, or one mm_malloc at a time with -B's
+ *     baseline. Returns how many blocks were allocated.
+ */
+static int batch_alloc(const traceop_t *op, char **blocks)
+{
+	int k;
+
+	if (!split_batches)
+		return backend->malloc_batch(op->size, op->count, (void **)&blocks[op->index]);
+	for (k = 0; k < op->count; k++)
+		if ((blocks[op->index + k] = backend->malloc(op->size)) == NULL)
+			break;
+	return k;
+}
+
+/*
+ * batch_free - Free blocks op->index.. of a batch with mm_free_batch,
+ *     which sorts its argument, so the pointers are copied to batch[]
+ *     first. -B's baseline frees them one mm_free at a time.
+ */
+static void batch_free(const traceop_t *op, char **blocks, void **batch)
+{
+	int k;
+
+	if (split_batches) {
+		for (k = 0; k < op->count; k++)
+			backend->free(blocks[op->index + k]);
+		return;
+	}
+	for (k = 0; k < op->count; k++)
+		batch[k] = blocks[op->index + k];
+	backend->free_batch(batch, op->count);
+}
+
 /**********************************************
  * The following routines manipulate tracefiles
  *********************************************/
@@ -700,9 +1086,12 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
 	FILE *tracefile;
 	trace_t *trace;
 	char type[MAXLINE];
-	int index, size;
+	int index;
+	size_t size, align;
 	int max_index = 0;
 	int op_index;
+	int count, max_count = 0;
+	double ops = 0;
 
 	if (verbose > 1)
 		printf("Reading tracefile: %s\n", filename);
@@ -754,30 +1143,71 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
 	index = 0;
 	op_index = 0;
 	while (fscanf(tracefile, "%s", type) != EOF) {
+		trace->ops[op_index].align = ALIGNMENT;
+		trace->ops[op_index].count = 1;
 		switch(type[0]) {
 			case 'a':
-				assert(2 == fscanf(tracefile, "%u %u", &index, &size));
+				assert(2 == fscanf(tracefile, "%d %zu", &index, &size));
 				trace->ops[op_index].type = ALLOC;
 				trace->ops[op_index].index = index;
 				trace->ops[op_index].size = size;
 				max_index = (index > max_index) ? index : max_index;
 				break;
 			case 'r':
-				assert(2 == fscanf(tracefile, "%u %u", &index, &size));
+				assert(2 == fscanf(tracefile, "%d %zu", &index, &size));
 				trace->ops[op_index].type = REALLOC;
 				trace->ops[op_index].index = index;
 				trace->ops[op_index].size = size;
 				max_index = (index > max_index) ? index : max_index;
 				break;
+			case 'c':
+				assert(2 == fscanf(tracefile, "%d %zu", &index, &size));
+				trace->ops[op_index].type = CALLOC;
+				trace->ops[op_index].index = index;
+				trace->ops[op_index].size = size;
+				max_index = (index > max_index) ? index : max_index;
+				break;
+			case 'm':
+				assert(3 == fscanf(tracefile, "%d %zu %zu", &index, &align, &size));
+				if (align < ALIGNMENT || (align & (align - 1)))
+					app_error("%s: alignment %zu is not a power of two of at "
+							"least %d", trace->filename, align, ALIGNMENT);
+				trace->ops[op_index].type = MEMALIGN;
+				trace->ops[op_index].index = index;
+				trace->ops[op_index].size = size;
+				trace->ops[op_index].align = align;
+				max_index = (index > max_index) ? index : max_index;
+				break;
 			case 'f':
-				assert(1 == fscanf(tracefile, "%ud", &index));
+				assert(1 == fscanf(tracefile, "%d", &index));
 				trace->ops[op_index].type = FREE;
 				trace->ops[op_index].index = index;
 				break;
+			case 'A':
+			case 'F':
+				if (type[0] == 'A') {
+					assert(3 == fscanf(tracefile, "%d %d %zu", &index, &count, &size));
+					trace->ops[op_index].type = BATCH_ALLOC;
+				} else {
+					assert(2 == fscanf(tracefile, "%d %d", &index, &count));
+					trace->ops[op_index].type = BATCH_FREE;
+					size = 0;
+				}
+				if (index < 0 || count < 1)
+					app_error("%s: bad batch of %d blocks from id %d",
+							trace->filename, count, index);
+				trace->ops[op_index].index = index;
+				trace->ops[op_index].size = size;
+				trace->ops[op_index].count = count;
+				max_index = (index + count - 1 > max_index) ?
+					index + count - 1 : max_index;
+				max_count = (count > max_count) ? count : max_count;
+				break;
 			default:
 				app_error("Bogus type character (%c) in tracefile %s\n",
 						type[0], trace->filename);
 		}
+		ops += trace->ops[op_index].count;
 		op_index++;
 		if(op_index == trace->num_ops) break;
 	}
@@ -785,10 +1215,14 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
 	assert(max_index == trace->num_ids - 1);
 	assert(trace->num_ops == op_index);
 
+	/* a batch is as many requests as it has blocks */
+	if ((trace->batch = malloc((max_count + 1) * sizeof(void *))) == NULL)
+		unix_error("malloc 6 failed in read_trace");
+
 	/* fill in the stats */
 	strcpy(stats->filename, trace->filename);
 	stats->weight = trace->weight;
-	stats->ops = trace->num_ops;
+	stats->ops = ops;
 
 	return trace;
 }
@@ -813,6 +1247,7 @@ static void free_trace(trace_t *trace)
 	free(trace->blocks);
 	free(trace->block_sizes);
 	free(trace->block_rand_base);
+	free(trace->batch);
 	free(trace);              /* and the trace record itself... */
 }
 
@@ -826,7 +1261,7 @@ static void free_trace(trace_t *trace)
  */
 static int eval_mm_valid(trace_t *trace, range_t **ranges)
 {
-	int i;
+	int i, j, n;
 	int index;
 	size_t size;
 	char *newp;
@@ -839,7 +1274,7 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
 	reinit_trace(trace);
 
 	/* Call the mm package's init function */
-	if (mm_init() < 0) {
+	if (backend->init() < 0) {
 		malloc_error(trace, 0, "mm_init failed.");
 		return 0;
 	}
@@ -853,7 +1288,7 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
 			range_t *r;
 			
 			/* Let the students check their own heap */
-			mm_checkheap(verbose);
+			backend->checkheap(verbose);
 
 			/* Now check that all our allocated blocks have the right data */
 			r = *ranges;
@@ -866,19 +1301,50 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
 		switch (trace->ops[i].type) {
 
 			case ALLOC: /* mm_malloc */
+			case CALLOC: /* mm_calloc */
+			case MEMALIGN: /* mm_memalign */
 
 				/* Call the student's malloc */
-				if ((p = mm_malloc(size)) == NULL) {
-					malloc_error(trace, i, "mm_malloc failed.");
+				if (trace->ops[i].type == CALLOC)
+					p = backend->calloc(1, size);
+				else if (trace->ops[i].type == MEMALIGN) {
+					if (backend->memalign == NULL) {
+						malloc_error(trace, i, "%s has no mm_memalign.",
+								backend->name);
+						return 0;
+					}
+					p = backend->memalign(trace->ops[i].align, size);
+				} else
+					p = backend->malloc(size);
+				if (p == NULL) {
+					malloc_error(trace, i, "mm_%s failed.",
+							trace->ops[i].type == CALLOC ? "calloc" :
+							trace->ops[i].type == MEMALIGN ? "memalign" : "malloc");
 					return 0;
 				}
 
+				/* A calloc'd payload must read as zero */
+				if (trace->ops[i].type == CALLOC) {
+					size_t j;
+					for (j = 0; j < size && p[j] == 0; j++)
+						;
+					if (j < size) {
+						malloc_error(trace, i, "mm_calloc payload has "
+								"nonzero byte %zu", j);
+						return 0;
+					}
+				}
+
 				/*
 				 * Test the range of the new block for correctness and add it
 				 * to the range list if OK. The block must be  be aligned properly,
 				 * and must not overlap any currently allocated block.
 				 */
-				if (add_range(ranges, p, size, trace, i, index) == 0)
+				if (add_range(ranges, p, size, trace->ops[i].align,
+							trace, i, index) == 0)
+					return 0;
+				if (check_usable(ranges, p, size,
+							trace->ops[i].align, trace, i) == 0)
 					return 0;
 
 				/* Remember region */
@@ -894,7 +1360,7 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
 
 				/* Call the student's realloc */
 				oldp = trace->blocks[index];
-				newp = mm_realloc(oldp, size);
+				newp = backend->realloc(oldp, size);
 				if( (newp == NULL) && (size != 0) ) {
 					malloc_error(trace, i, "mm_realloc failed.");
 					return 0;
@@ -911,7 +1377,10 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
 
 				/* Check new block for correctness and add it to range list */
 				if (size > 0) {
-					if(add_range(ranges, newp, size, trace, i, index) == 0)
+					if(add_range(ranges, newp, size, ALIGNMENT, trace, i, index) == 0)
+						return 0;
+					if (check_usable(ranges, newp, size, ALIGNMENT,
+								trace, i) == 0)
 						return 0;
 				}
 
@@ -939,7 +1408,40 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
 					p = trace->blocks[index];
 					remove_range(ranges, p);
 				}
-				mm_free(p);
+
+				/* Every other block goes back through mm_free_sized */
+				if (index > 0 && (index & 1))
+					backend->free_sized(p, trace->block_sizes[index]);
+				else
+					backend->free(p);
+				break;
+
+			case BATCH_ALLOC: /* mm_malloc_batch */
+				n = batch_alloc(&trace->ops[i], trace->blocks);
+				if (n < trace->ops[i].count) {
+					malloc_error(trace, i, "mm_malloc_batch got %d of %d blocks.",
+							n, trace->ops[i].count);
+					return 0;
+				}
+
+				/* Every block is checked like one from mm_malloc */
+				for (j = index; j < index + n; j++) {
+					p = trace->blocks[j];
+					if (add_range(ranges, p, size, ALIGNMENT, trace, i, j) == 0)
+						return 0;
+					if (check_usable(ranges, p, size, ALIGNMENT, trace, i) == 0)
+						return 0;
+					trace->block_sizes[j] = size;
+					randomize_block(trace, j);
+				}
+				break;
+
+			case BATCH_FREE: /* mm_free_batch */
+				for (j = index; j < index + trace->ops[i].count; j++) {
+					check_index(trace, i, j);
+					remove_range(ranges, trace->blocks[j]);
+				}
+				batch_free(&trace->ops[i], trace->blocks, trace->batch);
 				break;
 
 			default:
@@ -957,20 +1459,20 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
  *   The idea is to remember the high water mark "hwm" of the heap for
  *   an optimal allocator, i.e., no gaps and no internal fragmentation.
  *   Utilization is the ratio hwm/heapsize, where heapsize is the
- *   size of the heap in bytes after running the student's malloc
- *   package on the trace. Note that our implementation of mem_sbrk()
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap.
+ *   most memory the student's malloc package held at once on the
+ *   trace: the heap plus any regions from mem_map. mem_sbrk() can
+ *   lower the brk, so this is tracked by memlib rather than read off
+ *   the brk at the end.
  *
  *   A higher number is better: 1 is optimal.
  */
 static double eval_mm_util(trace_t *trace, int tracenum)
 {
-	int i;
+	int i, j;
 	int index;
-	int size, newsize, oldsize;
-	int max_total_size = 0;
-	int total_size = 0;
+	size_t size, newsize, oldsize;
+	size_t max_total_size = 0;
+	size_t total_size = 0;
 	char *p;
 	char *newp, *oldp;
 
@@ -978,17 +1480,25 @@ static double eval_mm_util(trace_t *trace, int tracenum)
 
 	/* initialize the heap and the mm malloc package */
 	mem_reset_brk();
-	if (mm_init() < 0)
+	if (backend->init() < 0)
 		app_error("trace %d: mm_init failed in eval_mm_util", tracenum);
 
 	for (i = 0;  i < trace->num_ops;  i++) {
 		switch (trace->ops[i].type) {
 
 			case ALLOC: /* mm_alloc */
+			case CALLOC: /* mm_calloc */
+			case MEMALIGN: /* mm_memalign */
 				index = trace->ops[i].index;
 				size = trace->ops[i].size;
 
-				if ((p = mm_malloc(size)) == NULL) {
+				if (trace->ops[i].type == CALLOC)
+					p = backend->calloc(1, size);
+				else if (trace->ops[i].type == MEMALIGN)
+					p = backend->memalign(trace->ops[i].align, size);
+				else
+					p = backend->malloc(size);
+				if (p == NULL) {
 					app_error("trace %d: mm_malloc failed in eval_mm_util",
 							tracenum);
 				}
@@ -1006,7 +1516,7 @@ static double eval_mm_util(trace_t *trace, int tracenum)
 				oldsize = trace->block_sizes[index];
 
 				oldp = trace->blocks[index];
-				if ((newp = mm_realloc(oldp,newsize)) == NULL && newsize != 0) {
+				if ((newp = backend->realloc(oldp,newsize)) == NULL && newsize != 0) {
 					app_error("trace %d: mm_realloc failed in eval_mm_util",
 							tracenum);
 				}
@@ -1028,11 +1538,29 @@ static double eval_mm_util(trace_t *trace, int tracenum)
 					p = trace->blocks[index];
 				}
 
-				mm_free(p);
+				backend->free(p);
 
 				total_size -= size;
 				break;
 
+			case BATCH_ALLOC: /* mm_malloc_batch */
+				index = trace->ops[i].index;
+				size = trace->ops[i].size;
+				if (batch_alloc(&trace->ops[i], trace->blocks) < trace->ops[i].count)
+					app_error("trace %d: mm_malloc_batch failed in eval_mm_util",
+							tracenum);
+				for (j = index; j < index + trace->ops[i].count; j++)
+					trace->block_sizes[j] = size;
+				total_size += trace->ops[i].count * size;
+				break;
+
+			case BATCH_FREE: /* mm_free_batch */
+				index = trace->ops[i].index;
+				for (j = index; j < index + trace->ops[i].count; j++)
+					total_size -= trace->block_sizes[j];
+				batch_free(&trace->ops[i], trace->blocks, trace->batch);
+				break;
+
 			default:
 				app_error("trace %d: Nonexistent request type in eval_mm_util",
 						tracenum);
@@ -1044,9 +1572,11 @@ static double eval_mm_util(trace_t *trace, int tracenum)
 	}
 
 	printf("max_total_size = %f\n", (double)max_total_size);
-	printf("mem_heapsize = %f\n", (double)mem_heapsize());
+	printf("mem_heapsize = %f\n", (double)mem_peak_footprint());
 	
-	return ((double)max_total_size / (double)mem_heapsize());
+	/* the heap may have been trimmed since its peak, and large blocks
+	   live in regions of their own */
+	return ((double)max_total_size / (double)mem_peak_footprint());
 }
 
 
@@ -1056,14 +1586,15 @@ static double eval_mm_util(trace_t *trace, int tracenum)
  */
 static void eval_mm_speed(void *ptr)
 {
-	int i, index, size, newsize;
+	int i, index;
+	size_t size, newsize;
 	char *p, *newp, *oldp, *block;
 	trace_t *trace = ((speed_t *)ptr)->trace;
 	reinit_trace(trace);
 
 	/* Reset the heap and initialize the mm package */
 	mem_reset_brk();
-	if (mm_init() < 0)
+	if (backend->init() < 0)
 		app_error("mm_init failed in eval_mm_speed");
 
 	/* Interpret each trace request */
@@ -1073,16 +1604,32 @@ static void eval_mm_speed(void *ptr)
 			case ALLOC: /* mm_malloc */
 				index = trace->ops[i].index;
 				size = trace->ops[i].size;
-				if ((p = mm_malloc(size)) == NULL)
+				if ((p = backend->malloc(size)) == NULL)
 					app_error("mm_malloc error in eval_mm_speed");
 				trace->blocks[index] = p;
 				break;
 
+			case CALLOC: /* mm_calloc */
+				index = trace->ops[i].index;
+				size = trace->ops[i].size;
+				if ((p = backend->calloc(1, size)) == NULL)
+					app_error("mm_calloc error in eval_mm_speed");
+				trace->blocks[index] = p;
+				break;
+
+			case MEMALIGN: /* mm_memalign */
+				index = trace->ops[i].index;
+				size = trace->ops[i].size;
+				if ((p = backend->memalign(trace->ops[i].align, size)) == NULL)
+					app_error("mm_memalign error in eval_mm_speed");
+				trace->blocks[index] = p;
+				break;
+
 			case REALLOC: /* mm_realloc */
 				index = trace->ops[i].index;
 				newsize = trace->ops[i].size;
 				oldp = trace->blocks[index];
-				if ((newp = mm_realloc(oldp,newsize)) == NULL && newsize != 0)
+				if ((newp = backend->realloc(oldp,newsize)) == NULL && newsize != 0)
 					app_error("mm_realloc error in eval_mm_speed");
 				trace->blocks[index] = newp;
 				break;
@@ -1094,7 +1641,16 @@ static void eval_mm_speed(void *ptr)
 				} else {
 					block = trace->blocks[index];
 				}
-				mm_free(block);
+				backend->free(block);
+				break;
+
+			case BATCH_ALLOC: /* mm_malloc_batch */
+				if (batch_alloc(&trace->ops[i], trace->blocks) < trace->ops[i].count)
+					app_error("mm_malloc_batch error in eval_mm_speed");
+				break;
+
+			case BATCH_FREE: /* mm_free_batch */
+				batch_free(&trace->ops[i], trace->blocks, trace->batch);
 				break;
 
 			default:
@@ -1102,6 +1658,558 @@ static void eval_mm_speed(void *ptr)
 		}
 }
 
+#ifdef THREAD_SAFE
+/*
+ * The thread-scaling mode. Every thread replays the whole trace against
+ * the one shared mm heap, using its own table of block pointers, so with
+ * n threads the heap carries n copies of the trace's live data. With -H
+ * each thread replays it on a heap of its own from mm_heap_create. Each
+ * block gets a tag byte that is checked again on realloc and free, which
+ * catches two threads being handed the same memory.
+ */
+#define THREAD_REPS 3 /* best of THREAD_REPS runs per thread count */
+
+typedef struct {
+	trace_t *trace;
+	char **blocks;  /* this thread's block pointers, one per trace index */
+	void **batch;   /* this thread's room for a batch of pointers */
+	mm_heap_t *heap; /* this thread's heap, NULL for the shared one (-H) */
+	int id;         /* thread number, mixed into the tag byte */
+	int nomem;      /* set if mm_malloc/mm_realloc returned NULL */
+	int garbled;    /* number of blocks whose tag byte was overwritten */
+} thread_arg_t;
+
+#define THREAD_TAG(arg, index) ((char)((index) * 31 + (arg)->id))
+
+/*
+ * thread_replay - Body of one thread: replay the trace once.
+ */
+static void *thread_replay(void *ptr)
+{
+	thread_arg_t *arg = ptr;
+	trace_t *trace = arg->trace;
+	int i, j, index;
+	size_t size;
+	char *p;
+
+	mm_heap_use(arg->heap);
+	for (i = 0;  i < trace->num_ops;  i++) {
+		index = trace->ops[i].index;
+		size = trace->ops[i].size;
+
+		switch (trace->ops[i].type) {
+			case ALLOC:
+			case CALLOC:
+			case MEMALIGN:
+				if (trace->ops[i].type == CALLOC)
+					p = mm_calloc(1, size);
+				else if (trace->ops[i].type == MEMALIGN)
+					p = mm_memalign(trace->ops[i].align, size);
+				else
+					p = mm_malloc(size);
+				if (p == NULL) {
+					arg->nomem = 1;
+					return NULL;
+				}
+				*p = THREAD_TAG(arg, index);
+				arg->blocks[index] = p;
+				break;
+
+			case REALLOC:
+				p = arg->blocks[index];
+				if (p != NULL && *p != THREAD_TAG(arg, index))
+					arg->garbled++;
+				if ((p = mm_realloc(p, size)) == NULL && size != 0) {
+					arg->nomem = 1;
+					return NULL;
+				}
+				if (p != NULL)
+					*p = THREAD_TAG(arg, index);
+				arg->blocks[index] = p;
+				break;
+
+			case FREE:
+				p = (index < 0) ? NULL : arg->blocks[index];
+				if (p != NULL && *p != THREAD_TAG(arg, index))
+					arg->garbled++;
+				mm_free(p);
+				break;
+
+			case BATCH_ALLOC:
+				if (batch_alloc(&trace->ops[i], arg->blocks) < trace->ops[i].count) {
+					arg->nomem = 1;
+					return NULL;
+				}
+				for (j = index; j < index + trace->ops[i].count; j++)
+					*arg->blocks[j] = THREAD_TAG(arg, j);
+				break;
+
+			case BATCH_FREE:
+				for (j = index; j < index + trace->ops[i].count; j++)
+					if (*arg->blocks[j] != THREAD_TAG(arg, j))
+						arg->garbled++;
+				batch_free(&trace->ops[i], arg->blocks, arg->batch);
+				break;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * eval_mm_threads - Time the trace with 1, 2, 4, ... maxthreads threads
+ *     and print the aggregate throughput for each thread count. If heaps
+ *     is set, every thread gets a fresh heap of its own for each run.
+ */
+static void eval_mm_threads(trace_t *trace, int maxthreads, int heaps)
+{
+	pthread_t *tids;
+	thread_arg_t *args;
+	struct timespec start, end;
+	double secs, best, base = 0;
+	int n, t, rep, nomem, garbled, ops = 0;
+
+	tids = malloc(maxthreads * sizeof(pthread_t));
+	args = calloc(maxthreads, sizeof(thread_arg_t));
+	if (tids == NULL || args == NULL)
+		unix_error("malloc failed in eval_mm_threads");
+	for (t = 0; t < trace->num_ops; t++)
+		ops += trace->ops[t].count;
+	for (t = 0; t < maxthreads; t++) {
+		args[t].trace = trace;
+		args[t].id = t;
+		if ((args[t].blocks = calloc(trace->num_ids, sizeof(char *))) == NULL ||
+				(args[t].batch = calloc(trace->num_ids, sizeof(void *))) == NULL)
+			unix_error("calloc failed in eval_mm_threads");
+	}
+
+	printf("\nThread scaling for mm malloc on %s%s:\n", trace->filename,
+			heaps ? " (a heap per thread)" : "");
+	printf("%8s%10s%10s%10s%9s\n", "threads", "ops", "secs", "Kops", "speedup");
+	for (n = 1; n <= maxthreads; n = (n < maxthreads && 2*n > maxthreads) ?
+			maxthreads : 2*n) {
+		best = DBL_MAX;
+		nomem = garbled = 0;
+		for (rep = 0; rep < THREAD_REPS && !nomem; rep++) {
+			mem_reset_brk();
+			if (mm_init() < 0)
+				app_error("mm_init failed in eval_mm_threads");
+			for (t = 0; t < n; t++)
+				if (heaps && (args[t].heap = mm_heap_create()) == NULL)
+					app_error("mm_heap_create failed in eval_mm_threads");
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			for (t = 0; t < n; t++) {
+				memset(args[t].blocks, 0, trace->num_ids * sizeof(char *));
+				args[t].nomem = args[t].garbled = 0;
+				if (pthread_create(&tids[t], NULL, thread_replay, &args[t]) != 0)
+					unix_error("pthread_create failed in eval_mm_threads");
+			}
+			for (t = 0; t < n; t++) {
+				pthread_join(tids[t], NULL);
+				nomem |= args[t].nomem;
+				garbled += args[t].garbled;
+			}
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			for (t = 0; t < n; t++) {
+				mm_heap_destroy(args[t].heap);
+				args[t].heap = NULL;
+			}
+
+			secs = (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+			best = (secs < best) ? secs : best;
+		}
+
+		if (garbled) {
+			errors++;
+			printf("ERROR [trace %s]: %d blocks garbled with %d threads\n",
+					trace->filename, garbled, n);
+		}
+		if (nomem) {
+			printf("%8d%10s%10s%10s%9s  (out of memory)\n", n, "-", "-", "-", "-");
+			break;
+		}
+		if (n == 1)
+			base = best;
+		printf("%8d%10d%10.6f%10.0f%8.2fx\n", n, n * ops, best,
+				(n * ops / 1e3) / best, (n * base) / best);
+	}
+
+	for (t = 0; t < maxthreads; t++) {
+		free(args[t].blocks);
+		free(args[t].batch);
+	}
+	free(args);
+	free(tids);
+}
+#endif
+
+/*
+ * The arena mode. The trace is cut into epochs of the given number of
+ * requests, and an arena is reset at every epoch boundary. A block that
+ * is allocated and freed within one epoch, and never reallocated, lives
+ * in the arena: it costs a pointer bump, and its free is a no-op. Every
+ * other block goes through mm_malloc and mm_free as usual.
+ * The arena replay is run once with every payload filled with a tag byte
+ * that is checked again on realloc and free, which catches an arena
+ * handing out memory that is still in use.
+ */
+#define ARENA_TAG(index) ((char)((index) * 31 + 7))
+
+/*
+ * arena_plan - Set in_arena[i] for every request i on a block that is
+ *     allocated and freed within one epoch and not reallocated in between.
+ *     Returns how many there are.
+ */
+static int arena_plan(const trace_t *trace, int epoch, char *in_arena)
+{
+	int *first;  /* request that allocated each block, -1 if none may */
+	char *cur;   /* whether each block lives in the arena right now */
+	int i, j, index, n = 0;
+
+	first = malloc(trace->num_ids * sizeof(int));
+	cur = calloc(trace->num_ids, 1);
+	if (first == NULL || cur == NULL)
+		unix_error("malloc failed in arena_plan");
+	for (i = 0; i < trace->num_ids; i++)
+		first[i] = -1;
+	memset(in_arena, 0, trace->num_ops);
+
+	/* mark the requests that start a block which dies in its epoch */
+	for (i = 0; i < trace->num_ops; i++) {
+		index = trace->ops[i].index;
+		switch (trace->ops[i].type) {
+			case ALLOC:
+			case CALLOC:
+				first[index] = i;
+				break;
+			case MEMALIGN: /* arenas only align to ALIGNMENT */
+			case REALLOC:  /* the block may move out of mm_malloc's heap */
+				first[index] = -1;
+				break;
+			case BATCH_ALLOC: /* batches always go through mm_malloc_batch */
+				for (j = index; j < index + trace->ops[i].count; j++)
+					first[j] = -1;
+				break;
+			case FREE:
+				if (index >= 0 && first[index] >= 0 &&
+						first[index] / epoch == i / epoch)
+					in_arena[first[index]] = 1;
+				break;
+			default:
+				break;
+		}
+	}
+
+	/* then the frees of those blocks */
+	for (i = 0; i < trace->num_ops; i++) {
+		index = trace->ops[i].index;
+		switch (trace->ops[i].type) {
+			case ALLOC:
+			case CALLOC:
+			case MEMALIGN:
+				cur[index] = in_arena[i];
+				break;
+			case FREE:
+				if (index >= 0)
+					in_arena[i] = cur[index];
+				break;
+			default:
+				break;
+		}
+		n += in_arena[i];
+	}
+
+	free(first);
+	free(cur);
+	return n;
+}
+
+/*
+ * arena_check - Count block index as garbled if its payload lost its tag
+ */
+static int arena_check(const trace_t *trace, int index)
+{
+	const char *p = trace->blocks[index];
+	size_t i;
+
+	for (i = 0; i < trace->block_sizes[index]; i++)
+		if (p[i] != ARENA_TAG(index))
+			return 1;
+	return 0;
+}
+
+/*
+ * arena_replay - Replay the trace with the requests marked in in_arena
+ *     served by an arena that is reset every epoch requests. With check
+ *     set, fill and check every payload; returns the number of blocks
+ *     found garbled.
+ */
+static int arena_replay(trace_t *trace, const char *in_arena, int epoch,
+		int check)
+{
+	mm_arena_t *arena;
+	int i, j, index, garbled = 0;
+	size_t size;
+	char *p, *oldp;
+
+	reinit_trace(trace);
+	mem_reset_brk();
+	if (mm_init() < 0)
+		app_error("mm_init failed in arena_replay");
+	if ((arena = mm_arena_create(0)) == NULL)
+		app_error("This build has no arenas (mm_arena_create failed)\n");
+
+	for (i = 0; i < trace->num_ops; i++) {
+		if (i > 0 && i % epoch == 0)
+			mm_arena_reset(arena);
+		index = trace->ops[i].index;
+		size = trace->ops[i].size;
+
+		switch (trace->ops[i].type) {
+			case ALLOC:
+			case CALLOC:
+			case MEMALIGN:
+				if (in_arena[i]) {
+					if ((p = mm_arena_alloc(arena, size)) != NULL &&
+							trace->ops[i].type == CALLOC)
+						memset(p, 0, size);
+				}
+				else if (trace->ops[i].type == CALLOC)
+					p = mm_calloc(1, size);
+				else if (trace->ops[i].type == MEMALIGN)
+					p = mm_memalign(trace->ops[i].align, size);
+				else
+					p = mm_malloc(size);
+				if (p == NULL)
+					app_error("out of memory in arena_replay");
+				trace->blocks[index] = p;
+				trace->block_sizes[index] = size;
+				if (check)
+					memset(p, ARENA_TAG(index), size);
+				break;
+
+			case REALLOC:
+				oldp = trace->blocks[index];
+				if (check)
+					garbled += arena_check(trace, index);
+				if ((p = mm_realloc(oldp, size)) == NULL && size != 0)
+					app_error("out of memory in arena_replay");
+				trace->blocks[index] = p;
+				trace->block_sizes[index] = size;
+				if (check && p != NULL)
+					memset(p, ARENA_TAG(index), size);
+				break;
+
+			case FREE:
+				if (index < 0) {
+					mm_free(NULL);
+					break;
+				}
+				if (check)
+					garbled += arena_check(trace, index);
+				if (!in_arena[i])
+					mm_free(trace->blocks[index]);
+				trace->block_sizes[index] = 0;
+				break;
+
+			case BATCH_ALLOC:
+				if (batch_alloc(&trace->ops[i], trace->blocks) < trace->ops[i].count)
+					app_error("out of memory in arena_replay");
+				for (j = index; j < index + trace->ops[i].count; j++) {
+					trace->block_sizes[j] = size;
+					if (check)
+						memset(trace->blocks[j], ARENA_TAG(j), size);
+				}
+				break;
+
+			case BATCH_FREE:
+				for (j = index; j < index + trace->ops[i].count; j++)
+					if (check)
+						garbled += arena_check(trace, j);
+				batch_free(&trace->ops[i], trace->blocks, trace->batch);
+				break;
+		}
+	}
+	mm_arena_destroy(arena);
+	return garbled;
+}
+
+/*
+ * eval_mm_arena_speed - The arena replay, as timed by fcyc()
+ */
+static void eval_mm_arena_speed(void *ptr)
+{
+	speed_t *params = ptr;
+
+	arena_replay(params->trace, params->in_arena, params->epoch, 0);
+}
+
+/*
+ * eval_mm_arena - Check the arena replay of the trace, then time it and
+ *     the usual replay and print one line comparing the two
+ */
+static void eval_mm_arena(trace_t *trace, int epoch)
+{
+	speed_t params;
+	char *in_arena;
+	int n, garbled;
+	double heap_secs, arena_secs, ops = 0;
+	size_t heap_peak, arena_peak;
+
+	if ((in_arena = malloc(trace->num_ops)) == NULL)
+		unix_error("malloc failed in eval_mm_arena");
+	for (n = 0; n < trace->num_ops; n++)
+		ops += trace->ops[n].count;
+	n = arena_plan(trace, epoch, in_arena);
+
+	if ((garbled = arena_replay(trace, in_arena, epoch, 1)) != 0) {
+		errors++;
+		printf("ERROR [trace %s]: %d blocks garbled in arenas\n",
+				trace->filename, garbled);
+	}
+
+	params.trace = trace;
+	params.ranges = NULL;
+	params.in_arena = in_arena;
+	params.epoch = epoch;
+	heap_secs = fsecs(eval_mm_speed, &params);
+	heap_peak = mem_peak_footprint();
+	arena_secs = fsecs(eval_mm_arena_speed, &params);
+	arena_peak = mem_peak_footprint();
+
+	printf("%7.0f%%%10zu%10zu%11.0f%11.0f%7.2fx  %s\n",
+			100.0 * n / trace->num_ops, heap_peak / 1024, arena_peak / 1024,
+			ops / 1e3 / heap_secs, ops / 1e3 / arena_secs,
+			heap_secs / arena_secs, trace->filename);
+	free(in_arena);
+}
+
+/*
+ * The node-churn benchmark. NODE_LIVE nodes of one size stay live while
+ * a random one is freed and replaced NODE_OPS times, as in a long-lived
+ * list or tree. Over the second quarter the live set doubles, and over
+ * the third it shrinks back, after which a pool gives its empty chunks
+ * back. Every node size is run once with mm_malloc and mm_free and once
+ * with an mm_pool_t. Each node carries a tag byte at both ends that is
+ * checked before it is freed.
+ */
+#define NODE_LIVE 4096
+#define NODE_OPS  (64*1024)
+#define NODE_TAG(k) ((char)((k) * 31 + 5))
+
+static const size_t node_sizes[] = { 16, 24, 48, 64, 128, 256 };
+
+/*
+ * churn_new - Allocate and tag the node for slot k
+ */
+static char *churn_new(churn_t *c, mm_pool_t *pool, int k)
+{
+	char *p = c->pool ? mm_pool_alloc(pool) : mm_malloc(c->size);
+
+	if (p == NULL)
+		app_error("out of memory in eval_churn");
+	p[0] = p[c->size - 1] = NODE_TAG(k);
+	c->ops++;
+	return p;
+}
+
+/*
+ * churn_free - Check and free the node in slot k
+ */
+static void churn_free(churn_t *c, mm_pool_t *pool, char *p, int k)
+{
+	if (p[0] != NODE_TAG(k) || p[c->size - 1] != NODE_TAG(k))
+		c->garbled++;
+	if (c->pool)
+		mm_pool_free(pool, p);
+	else
+		mm_free(p);
+	c->ops++;
+}
+
+/*
+ * eval_churn - One run of the benchmark, as timed by fcyc()
+ */
+static void eval_churn(void *ptr)
+{
+	static char *nodes[2*NODE_LIVE];
+	churn_t *c = ptr;
+	mm_pool_t *pool = NULL;
+	unsigned int seed = 1;
+	int i, k, live;
+
+	mem_reset_brk();
+	if (mm_init() < 0)
+		app_error("mm_init failed in eval_churn");
+	if (c->pool && (pool = mm_pool_create(c->size, 0)) == NULL)
+		app_error("This build has no pools (mm_pool_create failed)\n");
+	if (c->pool && !mm_pool_reserve(pool, NODE_LIVE))
+		app_error("mm_pool_reserve failed in eval_churn");
+	c->ops = c->garbled = 0;
+
+	for (live = 0; live < NODE_LIVE; live++)
+		nodes[live] = churn_new(c, pool, live);
+	for (i = 0; i < NODE_OPS; i++) {
+		if (i >= NODE_OPS/4 && i < NODE_OPS/2 && i % 4 == 0) {
+			nodes[live] = churn_new(c, pool, live);
+			live++;
+		}
+		if (i >= NODE_OPS/2 && i < 3*NODE_OPS/4 && i % 4 == 0) {
+			live--;
+			churn_free(c, pool, nodes[live], live);
+		}
+		if (i == 3*NODE_OPS/4 && c->pool)
+			c->released = mm_pool_release(pool);
+
+		seed = seed * 1103515245 + 12345;
+		k = (seed >> 8) % live;
+		churn_free(c, pool, nodes[k], k);
+		nodes[k] = churn_new(c, pool, k);
+	}
+
+	while (live > 0) {
+		live--;
+		churn_free(c, pool, nodes[live], live);
+	}
+	if (c->pool)
+		mm_pool_destroy(pool);
+}
+
+/*
+ * eval_mm_churn - Run the benchmark for every node size and print the
+ *     peak footprint and throughput of mm_malloc and of a pool
+ */
+static void eval_mm_churn(void)
+{
+	churn_t c[2];
+	double secs[2];
+	size_t peak[2];
+	int i, j;
+
+	printf("\nNode churn, %d to %d live nodes, %d replacements:\n",
+			NODE_LIVE, 2*NODE_LIVE, NODE_OPS);
+	printf("%8s%11s%11s%13s%11s%8s%10s\n", "size", "malloc KB", "pool KB",
+			"malloc Kops", "pool Kops", "ratio", "released");
+	for (i = 0; i < (int)(sizeof(node_sizes) / sizeof(node_sizes[0])); i++) {
+		for (j = 0; j < 2; j++) {
+			c[j].size = node_sizes[i];
+			c[j].pool = j;
+			c[j].released = 0;
+			secs[j] = fsecs(eval_churn, &c[j]);
+			peak[j] = mem_peak_footprint();
+			if (c[j].garbled) {
+				errors++;
+				printf("ERROR: %d nodes of %zu bytes garbled with %s\n",
+						c[j].garbled, c[j].size, j ? "a pool" : "mm_malloc");
+			}
+		}
+		printf("%8zu%11zu%11zu%13.0f%11.0f%7.2fx%10zu\n", node_sizes[i],
+				peak[0] / 1024, peak[1] / 1024,
+				c[0].ops / 1e3 / secs[0], c[1].ops / 1e3 / secs[1],
+				secs[0] / secs[1], c[1].released);
+	}
+}
+
 /*
  * eval_libc_valid - We run this function to make sure that the
  *    libc malloc can run to completion on the set of traces.
@@ -1110,7 +2218,8 @@ static void eval_mm_speed(void *ptr)
  */
 static int eval_libc_valid(trace_t *trace)
 {
-	int i, newsize;
+	int i, j;
+	size_t newsize;
 	char *p, *newp, *oldp;
 
 	reinit_trace(trace);
@@ -1126,6 +2235,23 @@ static int eval_libc_valid(trace_t *trace)
 				trace->blocks[trace->ops[i].index] = p;
 				break;
 
+			case CALLOC: /* calloc */
+				if ((p = calloc(1, trace->ops[i].size)) == NULL) {
+					malloc_error(trace, i, "libc calloc failed");
+					unix_error("System message");
+				}
+				trace->blocks[trace->ops[i].index] = p;
+				break;
+
+			case MEMALIGN: /* posix_memalign */
+				if (posix_memalign((void **)&p, trace->ops[i].align,
+							trace->ops[i].size) != 0) {
+					malloc_error(trace, i, "libc posix_memalign failed");
+					unix_error("System message");
+				}
+				trace->blocks[trace->ops[i].index] = p;
+				break;
+
 			case REALLOC: /* realloc */
 				newsize = trace->ops[i].size;
 				oldp = trace->blocks[trace->ops[i].index];
@@ -1144,6 +2270,21 @@ static int eval_libc_valid(trace_t *trace)
 				}
 				break;
 
+			case BATCH_ALLOC: /* malloc, one block at a time */
+				for (j = 0; j < trace->ops[i].count; j++) {
+					if ((p = malloc(trace->ops[i].size)) == NULL) {
+						malloc_error(trace, i, "libc malloc failed");
+						unix_error("System message");
+					}
+					trace->blocks[trace->ops[i].index + j] = p;
+				}
+				break;
+
+			case BATCH_FREE: /* free, one block at a time */
+				for (j = 0; j < trace->ops[i].count; j++)
+					free(trace->blocks[trace->ops[i].index + j]);
+				break;
+
 			default:
 				app_error("invalid operation type  in eval_libc_valid");
 		}
@@ -1159,8 +2300,9 @@ static int eval_libc_valid(trace_t *trace)
  */
 static void eval_libc_speed(void *ptr)
 {
-	int i;
-	int index, size, newsize;
+	int i, j;
+	int index;
+	size_t size, newsize;
 	char *p, *newp, *oldp, *block;
 	trace_t *trace = ((speed_t *)ptr)->trace;
 
@@ -1176,6 +2318,22 @@ static void eval_libc_speed(void *ptr)
 				trace->blocks[index] = p;
 				break;
 
+			case CALLOC: /* calloc */
+				index = trace->ops[i].index;
+				size = trace->ops[i].size;
+				if ((p = calloc(1, size)) == NULL)
+					unix_error("calloc failed in eval_libc_speed");
+				trace->blocks[index] = p;
+				break;
+
+			case MEMALIGN: /* posix_memalign */
+				index = trace->ops[i].index;
+				size = trace->ops[i].size;
+				if (posix_memalign((void **)&p, trace->ops[i].align, size) != 0)
+					unix_error("posix_memalign failed in eval_libc_speed");
+				trace->blocks[index] = p;
+				break;
+
 			case REALLOC: /* realloc */
 				index = trace->ops[i].index;
 				newsize = trace->ops[i].size;
@@ -1195,6 +2353,20 @@ static void eval_libc_speed(void *ptr)
 					free(0);
 				}
 				break;
+
+			case BATCH_ALLOC: /* malloc, one block at a time */
+				index = trace->ops[i].index;
+				size = trace->ops[i].size;
+				for (j = index; j < index + trace->ops[i].count; j++)
+					if ((trace->blocks[j] = malloc(size)) == NULL)
+						unix_error("malloc failed in eval_libc_speed");
+				break;
+
+			case BATCH_FREE: /* free, one block at a time */
+				index = trace->ops[i].index;
+				for (j = index; j < index + trace->ops[i].count; j++)
+					free(trace->blocks[j]);
+				break;
 		}
 	}
 }
@@ -1266,6 +2438,113 @@ static void printresults(int n, stats_t *stats)
 
 }
 
+/*
+ * printcompare - prints the per-trace change in utilization and
+ *     throughput between two runs of the mm malloc package
+ */
+static void printcompare(int n, stats_t *before, stats_t *after)
+{
+	int i;
+
+	printf("%9s%8s%8s%10s%10s%8s  %s\n",
+			"util", "", "delta", "Kops", "", "ratio", "trace");
+	for (i=0; i < n; i++) {
+		if (!before[i].valid || !after[i].valid) {
+			printf("%9s%8s%8s%10s%10s%8s  %s\n",
+					"-", "-", "-", "-", "-", "-", after[i].filename);
+			continue;
+		}
+		printf("%8.0f%%%7.0f%%%+7.1f%%%10.0f%10.0f%7.2fx  %s\n",
+				before[i].util*100.0,
+				after[i].util*100.0,
+				(after[i].util - before[i].util)*100.0,
+				(before[i].ops/1e3)/before[i].secs,
+				(after[i].ops/1e3)/after[i].secs,
+				before[i].secs/after[i].secs,
+				after[i].filename);
+	}
+}
+
+/*
+ * printreallocs - prints, per trace, how many reallocs copied their
+ *     payload and how many finished in place without copying
+ */
+static void printreallocs(int n, stats_t *stats)
+{
+	int i;
+	unsigned long copies = 0, copied = 0, avoided = 0, saved = 0;
+
+	printf("%8s%10s%10s%10s  %s\n",
+			"copies", "bytes", "avoided", "bytes", "trace");
+	for (i=0; i < n; i++) {
+		if (!stats[i].valid) {
+			printf("%8s%10s%10s%10s  %s\n",
+					"-", "-", "-", "-", stats[i].filename);
+			continue;
+		}
+		printf("%8lu%10lu%10lu%10lu  %s\n",
+				stats[i].counters.realloc_copies,
+				stats[i].counters.copied_bytes,
+				stats[i].counters.copies_avoided,
+				stats[i].counters.avoided_bytes,
+				stats[i].filename);
+		copies += stats[i].counters.realloc_copies;
+		copied += stats[i].counters.copied_bytes;
+		avoided += stats[i].counters.copies_avoided;
+		saved += stats[i].counters.avoided_bytes;
+	}
+	printf("%8lu%10lu%10lu%10lu\n", copies, copied, avoided, saved);
+}
+
+/*
+ * printfast - prints, per trace, how many mallocs were served from a
+ *     fast bin and how many times the fast bins were consolidated
+ */
+static void printfast(int n, stats_t *stats)
+{
+	int i;
+
+	printf("%10s%10s  %s\n", "hits", "merges", "trace");
+	for (i=0; i < n; i++) {
+		if (!stats[i].valid) {
+			printf("%10s%10s  %s\n", "-", "-", stats[i].filename);
+			continue;
+		}
+		printf("%10lu%10lu  %s\n",
+				stats[i].counters.fast_hits,
+				stats[i].counters.consolidations,
+				stats[i].filename);
+	}
+}
+
+/*
+ * printresident - prints, per trace, the peak and final footprint (heap
+ *     plus mapped regions) of the correctness run, how much of the final heap was resident in memory,
+ *     how much was still resident after mm_trim(0), and how many bytes
+ *     of free pages the allocator purged along the way
+ */
+static void printresident(int n, stats_t *stats)
+{
+	int i;
+
+	printf("%10s%10s%10s%10s%10s  %s\n",
+			"peak", "heap", "resident", "trimmed", "purged", "trace");
+	for (i=0; i < n; i++) {
+		if (!stats[i].valid) {
+			printf("%10s%10s%10s%10s%10s  %s\n",
+					"-", "-", "-", "-", "-", stats[i].filename);
+			continue;
+		}
+		printf("%10lu%10lu%10lu%10lu%10lu  %s\n",
+				(unsigned long)stats[i].peak_heap,
+				(unsigned long)stats[i].end_heap,
+				(unsigned long)stats[i].resident,
+				(unsigned long)stats[i].trimmed,
+				stats[i].counters.purged_bytes,
+				stats[i].filename);
+	}
+}
+
 /*
  * app_error - Report an arbitrary application error
  */
@@ -1305,13 +2584,359 @@ void malloc_error(const trace_t *trace, int opnum, const char *fmt, ...)
 
 	va_end(ap);
 }
+/*
+ * The large-block churn benchmark. LARGE_COUNT blocks of 16 to 18 KB,
+ * kept apart by small live blocks, are freed largest first and then
+ * allocated again largest first, over and over, as when a set of
+ * buffers is dropped and rebuilt. The free blocks come back onto a list
+ * smallest first, so a first-fit search walks past half of them on
+ * average, while the size tree takes O(log n) steps. Each run is made
+ * with the large free blocks on a list (M_TREE 0) and in the tree, for a
+ * growing number of blocks, and the time per malloc or free is reported.
+ * Each block carries a tag byte at both ends that is checked before it
+ * is freed.
+ */
+#define LARGE_MIN  (16*1024)
+#define LARGE_SEP  128
+#define LARGE_OPS  (64*1024)
+#define LARGE_SIZE(k) (LARGE_MIN + 2*(k))
+#define LARGE_TAG(k) ((char)((k) * 37 + 11))
+
+static const int large_count[] = { 16, 64, 256, 1024 };
+
+/*
+ * large_new - Allocate and tag the block for slot k
+ */
+static char *large_new(large_t *l, int k)
+{
+	char *p = mm_malloc(LARGE_SIZE(k));
+
+	if (p == NULL)
+		app_error("out of memory in eval_large");
+	p[0] = p[LARGE_SIZE(k) - 1] = LARGE_TAG(k);
+	l->ops++;
+	return p;
+}
+
+/*
+ * eval_large - One run of the benchmark, as timed by fcyc()
+ */
+static void eval_large(void *ptr)
+{
+	static char *blocks[1024];
+	large_t *l = ptr;
+	int k;
+
+	mem_reset_brk();
+	mm_mallopt(M_TREE, l->tree);
+	if (mm_init() < 0)
+		app_error("mm_init failed in eval_large");
+	l->ops = l->garbled = 0;
+
+	for (k = 0; k < l->count; k++) {
+		blocks[k] = large_new(l, k);
+		if (mm_malloc(LARGE_SEP) == NULL)
+			app_error("out of memory in eval_large");
+	}
+	while (l->ops < LARGE_OPS) {
+		for (k = l->count - 1; k >= 0; k--) {
+			if (blocks[k][0] != LARGE_TAG(k) ||
+					blocks[k][LARGE_SIZE(k) - 1] != LARGE_TAG(k))
+				l->garbled++;
+			mm_free(blocks[k]);
+			l->ops++;
+		}
+		for (k = l->count - 1; k >= 0; k--)
+			blocks[k] = large_new(l, k);
+	}
+	mm_mallopt(M_TREE, 0);
+}
+
+/*
+ * eval_mm_large - Run the benchmark for every number of blocks and print
+ *     the time per request with a list and with the size tree
+ */
+static void eval_mm_large(void)
+{
+	large_t l[2];
+	double secs[2];
+	int i, j;
+
+	if (!mm_mallopt(M_TREE, 0)) {
+		printf("\nThis build has no size tree (M_TREE).\n");
+		return;
+	}
+	printf("\nLarge-block churn, %d requests:\n", LARGE_OPS);
+	printf("%8s%11s%11s%8s\n", "blocks", "list ns", "tree ns", "ratio");
+	for (i = 0; i < (int)(sizeof(large_count) / sizeof(large_count[0])); i++) {
+		for (j = 0; j < 2; j++) {
+			l[j].count = large_count[i];
+			l[j].tree = j;
+			secs[j] = fsecs(eval_large, &l[j]);
+			if (l[j].garbled) {
+				errors++;
+				printf("ERROR: %d large blocks garbled with %s\n",
+						l[j].garbled, j ? "the tree" : "a list");
+			}
+		}
+		printf("%8d%11.0f%11.0f%7.2fx\n", large_count[i],
+				secs[0] * 1e9 / l[0].ops, secs[1] * 1e9 / l[1].ops,
+				secs[0] / secs[1]);
+	}
+}
+
+/*
+ * The pluggable backends (-b). Each shared object in the list is an mm
+ * package built with "make backends", e.g. mm-implicit.so. mdriver
+ * exports memlib, which the package calls back into. It must define
+ * mm_init, mm_malloc, mm_free and mm_realloc; the rest of mm.h is
+ * optional, and stand-ins built on those four replace what is missing.
+ * Without mm_memalign, traces with memalign requests fail; without
+ * mm_usable_size, the usable bytes of blocks go unchecked.
+ */
+
+/*
+ * load_backend - dlopen one shared object and look up its mm package
+ */
+static backend_t *load_backend(const char *path)
+{
+	backend_t *b;
+	char *file;
+	const char *name;
+
+	if ((b = calloc(1, sizeof(*b))) == NULL ||
+			(file = malloc(strlen(path) + 3)) == NULL)
+		unix_error("load_backend malloc failed");
+
+	/* dlopen only looks in the current directory for a path with a '/' */
+	sprintf(file, "%s%s", strchr(path, '/') ? "" : "./", path);
+	if ((b->handle = dlopen(file, RTLD_NOW | RTLD_LOCAL)) == NULL)
+		app_error("%s\n", dlerror());
+	free(file);
+
+	/* The name is the file name without its directory or ".so" */
+	name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+	b->name = strndup(name, strstr(name, ".so") ? (size_t)(strstr(name, ".so") - name)
+			: strlen(name));
+
+#define LOOKUP(field, sym) (*(void **)&b->field = dlsym(b->handle, sym))
+	if (!LOOKUP(init, "mm_init") || !LOOKUP(malloc, "mm_malloc") ||
+			!LOOKUP(free, "mm_free") || !LOOKUP(realloc, "mm_realloc"))
+		app_error("%s has no mm_init, mm_malloc, mm_free or mm_realloc\n", path);
+	LOOKUP(memalign, "mm_memalign");
+	LOOKUP(usable_size, "mm_usable_size");
+	if (!LOOKUP(calloc, "mm_calloc"))
+		b->calloc = any_calloc;
+	if (!LOOKUP(free_sized, "mm_free_sized"))
+		b->free_sized = any_free_sized;
+	if (!LOOKUP(malloc_batch, "mm_malloc_batch"))
+		b->malloc_batch = any_malloc_batch;
+	if (!LOOKUP(free_batch, "mm_free_batch"))
+		b->free_batch = any_free_batch;
+	if (!LOOKUP(good_size, "mm_good_size"))
+		b->good_size = any_good_size;
+	if (!LOOKUP(checkheap, "mm_checkheap"))
+		b->checkheap = any_checkheap;
+#undef LOOKUP
+	return b;
+}
+
+/*
+ * any_* - Stand-ins for the parts of mm.h a backend leaves out, made
+ *     of the calls it does have
+ */
+static void *any_calloc(size_t nmemb, size_t size)
+{
+	void *p;
+
+	if (nmemb != 0 && (nmemb * size) / nmemb != size)
+		return NULL;
+	if ((p = backend->malloc(nmemb * size)) != NULL)
+		memset(p, 0, nmemb * size);
+	return p;
+}
+
+static void any_free_sized(void *ptr, size_t size __attribute__((unused)))
+{
+	backend->free(ptr);
+}
+
+static size_t any_malloc_batch(size_t size, size_t n, void **out)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		if ((out[i] = backend->malloc(size)) == NULL)
+			break;
+	return i;
+}
+
+static void any_free_batch(void **ptrs, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		backend->free(ptrs[i]);
+}
+
+static size_t any_good_size(size_t size)
+{
+	return size;
+}
+
+static void any_checkheap(int verbose __attribute__((unused)))
+{
+}
+
+/*
+ * eval_backends - Read every trace once, then run it on libc and on
+ *     each mm package in the comma-separated list: correctness first,
+ *     and utilization and throughput if that passes.
+ */
+static void eval_backends(int n, const char *tracedir, char **tracefiles,
+		char *list)
+{
+	backend_t **backends = NULL;
+	stats_t **stats = NULL;
+	stats_t *libc_stats;
+	trace_t **traces;
+	range_t *ranges = NULL;
+	speed_t speed_params;
+	char *path;
+	int nb = 0, b, i;
+
+	for (path = strtok(list, ","); path != NULL; path = strtok(NULL, ",")) {
+		if ((backends = realloc(backends, (nb + 1) * sizeof(*backends))) == NULL ||
+				(stats = realloc(stats, (nb + 1) * sizeof(*stats))) == NULL ||
+				(stats[nb] = calloc(n, sizeof(stats_t))) == NULL)
+			unix_error("eval_backends malloc failed");
+		backends[nb++] = load_backend(path);
+	}
+	if (nb == 0)
+		app_error("-b needs at least one shared object\n");
+
+	if ((libc_stats = calloc(n, sizeof(stats_t))) == NULL ||
+			(traces = calloc(n, sizeof(trace_t *))) == NULL)
+		unix_error("eval_backends calloc failed");
+	for (i = 0; i < n; i++) {
+		traces[i] = read_trace(&libc_stats[i], tracedir, tracefiles[i]);
+		strcpy(libc_stats[i].filename, traces[i]->filename);
+		for (b = 0; b < nb; b++)
+			stats[b][i] = libc_stats[i];
+	}
+
+	for (i = 0; i < n; i++) {
+		libc_stats[i].valid = eval_libc_valid(traces[i]);
+		if (libc_stats[i].valid) {
+			speed_params.trace = traces[i];
+			libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+		}
+	}
+
+	for (b = 0; b < nb; b++) {
+		backend = backends[b];
+		if (verbose > 1)
+			printf("\nTesting %s\n", backend->name);
+		for (i = 0; i < n; i++) {
+			stats[b][i].valid = eval_mm_valid(traces[i], &ranges);
+			if (!stats[b][i].valid)
+				continue;
+			stats[b][i].util = eval_mm_util(traces[i], i);
+			speed_params.trace = traces[i];
+			speed_params.ranges = ranges;
+			stats[b][i].secs = fsecs(eval_mm_speed, &speed_params);
+		}
+		if (verbose) {
+			printf("\nResults for %s:\n", backend->name);
+			printresults(n, stats[b]);
+		}
+	}
+	backend = &linked_mm;
+
+	printf("\n");
+	printbackends(n, nb, backends, stats, libc_stats);
+
+	for (i = 0; i < n; i++)
+		free_trace(traces[i]);
+	clear_ranges(&ranges);
+	for (b = 0; b < nb; b++) {
+		dlclose(backends[b]->handle);
+		free((char *)backends[b]->name);
+		free(backends[b]);
+		free(stats[b]);
+	}
+	free(backends);
+	free(stats);
+	free(libc_stats);
+	free(traces);
+}
+
+/*
+ * printbackends - prints the utilization and throughput of each mm
+ *     package next to the throughput of libc, per trace, with the
+ *     weighted averages underneath
+ */
+static void printbackends(int n, int nb, backend_t **backends,
+		stats_t **stats, stats_t *libc_stats)
+{
+	double sumops, sumsecs, sumutil;
+	int b, i, weight;
+
+	for (b = 0; b < nb; b++)
+		printf("%15.15s", backends[b]->name);
+	printf("%9s\n", "libc");
+	for (b = 0; b < nb; b++)
+		printf("%6s%9s", "util", "Kops");
+	printf("%9s  %s\n", "Kops", "trace");
+
+	for (i = 0; i < n; i++) {
+		for (b = 0; b < nb; b++) {
+			if (stats[b][i].valid)
+				printf("%5.0f%%%9.0f", stats[b][i].util*100.0,
+						(stats[b][i].ops/1e3)/stats[b][i].secs);
+			else
+				printf("%6s%9s", "-", "-");
+		}
+		if (libc_stats[i].valid)
+			printf("%9.0f", (libc_stats[i].ops/1e3)/libc_stats[i].secs);
+		else
+			printf("%9s", "-");
+		printf("  %s\n", libc_stats[i].filename);
+	}
+
+	/* A package that failed a weighted trace gets no average */
+	for (b = 0; b <= nb; b++) {
+		stats_t *s = (b < nb) ? stats[b] : libc_stats;
+
+		sumops = sumsecs = sumutil = 0;
+		weight = 0;
+		for (i = 0; i < n; i++) {
+			if (s[i].weight == 0)
+				continue;
+			if (!s[i].valid)
+				break;
+			sumops += s[i].ops * s[i].weight;
+			sumsecs += s[i].secs * s[i].weight;
+			sumutil += s[i].util * s[i].weight;
+			weight += s[i].weight;
+		}
+		if (b == nb)
+			printf("%9.0f", (i < n || sumsecs == 0) ? 0 : (sumops/1e3)/sumsecs);
+		else if (i < n || weight == 0)
+			printf("%6s%9s", "-", "-");
+		else
+			printf("%5.0f%%%9.0f", (sumutil/weight)*100.0,
+					sumsecs == 0 ? 0 : (sumops/1e3)/sumsecs);
+	}
+	printf("  %s\n", "average");
+}
 
 /*
  * usage - Explain the command line arguments
  */
 static void usage(void)
 {
-	fprintf(stderr, "Usage: mdriver [-hlVdD] [-f <file>]\n");
+	fprintf(stderr, "Usage: mdriver [-hlVdDSRZMBPHQLO] [-b <so,...>] [-f <file>]\n");
 	fprintf(stderr, "Options\n");
 	fprintf(stderr, "\t-d <i>     Debug: 0 off; 1 default; 2 lots.\n");
 	fprintf(stderr, "\t-D         Equivalent to -d2.\n");
@@ -1319,8 +2944,21 @@ static void usage(void)
 	fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
 	fprintf(stderr, "\t-h         Print this message.\n");
 	fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+	fprintf(stderr, "\t-S         Compare mm malloc with slab pages off and on.\n");
+	fprintf(stderr, "\t-R         Report realloc copies made and avoided per trace.\n");
+	fprintf(stderr, "\t-Z         Compare mm_calloc with known-zero tracking off and on.\n");
+	fprintf(stderr, "\t-M         Report peak, final and resident memory per trace.\n");
+	fprintf(stderr, "\t-B         Compare batch requests made one block at a time and batched.\n");
+	fprintf(stderr, "\t-Q         Compare mm malloc with fast bins off and on.\n");
+	fprintf(stderr, "\t-O         Compare mm malloc with address-ordered fit off and on.\n");
 	fprintf(stderr, "\t-V         Print diagnostics as each trace is run.\n");
 	fprintf(stderr, "\t-v <i>     Set Verbosity Level to <i>\n");
 	fprintf(stderr, "\t-s <s>     Timeout after s secs (default no timeout)\n");
+	fprintf(stderr, "\t-T <n>     Report throughput with 1..n threads (mdriver-mt only).\n");
+	fprintf(stderr, "\t-H         With -T, give every thread a heap of its own.\n");
+	fprintf(stderr, "\t-E <n>     Compare with blocks that die within n requests in arenas.\n");
+	fprintf(stderr, "\t-P         Compare mm_pool_t with mm_malloc on node churn.\n");
+	fprintf(stderr, "\t-L         Compare the size tree with a list on large-block churn.\n");
+	fprintf(stderr, "\t-b <list>  Compare the mm packages in these shared objects with libc.\n");
 	fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
 }
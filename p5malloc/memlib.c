@@ -3,6 +3,7 @@
  *            allows us to interleave calls from the student's malloc package 
  *            with the system's malloc package in libc.
  */
+#define _GNU_SOURCE          /* for mremap */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -14,17 +15,74 @@
 #include "memlib.h"
 #include "config.h"
 
+/* regions handed out by mem_map, outside the brk heap */
+typedef struct mem_region {
+    char *lo;                    /* first byte of the mapping */
+    size_t len;                  /* its length, a multiple of mem_page */
+    struct mem_region *next;
+} mem_region_t;
+
+/*
+ * One simulated memory system: a brk heap and the regions mapped next to
+ * it. mem_init sets up the default one; mem_create makes more, each with
+ * MAX_HEAP bytes of its own, and mem_use picks the one that the calls
+ * below work on in the calling thread.
+ */
+struct mem_heap {
+    char *heap;              /* MAX_HEAP bytes of mmap'd memory */
+    char *brk;               /* points to last byte of heap */
+    char *max_addr;          /* largest legal heap address */
+    char *dirty;             /* bytes from here up have never been handed out */
+    char *peak;              /* highest brk since the last reset */
+    mem_region_t *regions;
+    size_t mapped;           /* bytes in regions */
+    size_t peak_fp;          /* largest heap + mapped bytes since the last reset */
+};
+
 /* private variables */
-static char heap[MAX_HEAP];
-static char *mem_brk = heap; /* points to last byte of heap */
-static char *mem_max_addr = heap + MAX_HEAP;  /* largest legal heap address */ 
+static mem_heap_t mem_default;
+static __thread mem_heap_t *mem = &mem_default; /* the instance in use */
+static size_t mem_page;      /* the system page size */
+
+/* page rounding */
+#define PAGE_UP(p)   ((char *)(((size_t)(p) + mem_page - 1) & ~(mem_page - 1)))
+#define PAGE_DOWN(p) ((char *)((size_t)(p) & ~(mem_page - 1)))
+
+static void mem_unmap_all(void);
+static void mem_note_peak(void);
+
+/*
+ * mem_reserve - map the MAX_HEAP bytes of m's heap as a private
+ *    anonymous mapping, so pages are only resident once touched and can
+ *    be handed back with madvise. Returns -1 if there is no room.
+ */
+static int mem_reserve(mem_heap_t *m)
+{
+    m->heap = mmap(NULL, MAX_HEAP, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (m->heap == MAP_FAILED) {
+	m->heap = NULL;
+	return -1;
+    }
+    m->max_addr = m->heap + MAX_HEAP;
+    m->dirty = m->heap;
+    m->brk = m->heap;
+    m->peak = m->heap;
+    mem_page = (size_t)getpagesize();
+    return 0;
+}
 
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(void)
 {
-  mem_brk = heap;                  /* heap is empty initially */
+  if (mem->heap == NULL && mem_reserve(mem) < 0) {
+    fprintf(stderr, "ERROR: mem_init failed. Could not map the heap...\n");
+    exit(1);
+  }
+  mem->brk = mem->heap;            /* heap is empty initially */
+  mem->peak = mem->heap;
 }
 
 /* 
@@ -32,41 +90,303 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
-  /*    free(mem_start_brk); */
+  mem_unmap_all();
+  if (mem->heap != NULL)
+    munmap(mem->heap, MAX_HEAP);
+  mem->heap = NULL;
+}
+
+/*
+ * mem_create - make a memory system with a heap of its own, empty, next
+ *    to the default one. Returns NULL if there is no room for it.
+ */
+mem_heap_t *mem_create(void)
+{
+    mem_heap_t *m;
+
+    if ((m = calloc(1, sizeof(*m))) == NULL)
+	return NULL;
+    if (mem_reserve(m) < 0) {
+	free(m);
+	errno = ENOMEM;
+	return NULL;
+    }
+    return m;
+}
+
+/*
+ * mem_destroy - give back m's heap and every region mapped in it. No
+ *    thread may be using m.
+ */
+void mem_destroy(mem_heap_t *m)
+{
+    mem_heap_t *old = mem_use(m);
+
+    mem_unmap_all();
+    munmap(m->heap, MAX_HEAP);
+    mem_use(old != m ? old : NULL);
+    free(m);
+}
+
+/*
+ * mem_use - make the calling thread work on m (the default memory
+ *    system if m is NULL) and return the one it worked on before
+ */
+mem_heap_t *mem_use(mem_heap_t *m)
+{
+    mem_heap_t *old = mem;
+
+    mem = (m != NULL) ? m : &mem_default;
+    return old;
 }
 
 /*
- * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ * mem_reset_brk - reset the simulated brk pointer to make an empty heap,
+ *    and drop every region still mapped by mem_map
  */
 void mem_reset_brk()
 {
-    mem_brk = heap;
+    mem_unmap_all();
+    mem->brk = mem->heap;
+    mem->peak = mem->heap;
+    mem->peak_fp = 0;
 }
 
 /* 
  * mem_sbrk - simple model of the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    by incr bytes and returns the start address of the new area. A
+ *    negative incr gives the top -incr bytes back. The new area is not
+ *    cleared; only the part of it from mem_clean_lo up reads as zero.
  */
-void *mem_sbrk(int incr) 
+void *mem_sbrk(intptr_t incr) 
 {
-    char *old_brk = mem_brk;
+    char *old_brk = mem->brk;
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+    if (incr < 0) {
+	if (mem->brk + incr < mem->heap) {
+	    errno = EINVAL;
+	    fprintf(stderr, "ERROR: mem_sbrk failed. Shrank below the heap start...\n");
+	    return (void *)-1;
+	}
+	mem->brk += incr;
+	mem_purge(mem->brk, old_brk - mem->brk);
+	/* clear the part pages at either end that the purge left, so that
+	   everything from the brk up is clean again */
+	if (mem->dirty <= PAGE_UP(old_brk) && mem->dirty > mem->brk) {
+	    char *lo = PAGE_UP(mem->brk), *hi = PAGE_DOWN(old_brk);
+
+	    if (hi <= lo)
+		memset(mem->brk, 0, mem->dirty - mem->brk);
+	    else {
+		memset(mem->brk, 0, lo - mem->brk);
+		if (mem->dirty > hi)
+		    memset(hi, 0, mem->dirty - hi);
+	    }
+	    mem->dirty = mem->brk;
+	}
+	return (void *)old_brk;
+    }
+    if ((mem->brk + incr) > mem->max_addr) {
 	errno = ENOMEM;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
     }
-    mem_brk += incr;
+    mem->brk += incr;
+    if (mem->brk > mem->peak)
+	mem->peak = mem->brk;
+    mem_note_peak();
+    if (mem->brk > mem->dirty)
+	mem->dirty = mem->brk;
     return (void *)old_brk;
 }
 
+/*
+ * mem_map - map a region of at least len bytes outside the heap, for
+ *    blocks too big to carve from it. Like fresh pages from the OS, it
+ *    reads as zero. Returns NULL if the system has no room for it.
+ */
+void *mem_map(size_t len)
+{
+    mem_region_t *r;
+    char *lo;
+
+    len = (size_t)PAGE_UP(len);
+    if (len == 0 || (r = malloc(sizeof(*r))) == NULL)
+	return NULL;
+    lo = mmap(NULL, len, PROT_READ | PROT_WRITE,
+	      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (lo == MAP_FAILED) {
+	free(r);
+	errno = ENOMEM;
+	return NULL;
+    }
+    r->lo = lo;
+    r->len = len;
+    r->next = mem->regions;
+    mem->regions = r;
+    mem->mapped += len;
+    mem_note_peak();
+    return lo;
+}
+
+/*
+ * mem_region - return the record of the region that holds lo
+ */
+static mem_region_t **mem_region(void *lo)
+{
+    mem_region_t **rp;
+
+    for (rp = &mem->regions; *rp != NULL; rp = &(*rp)->next)
+	if ((char *)lo >= (*rp)->lo && (char *)lo < (*rp)->lo + (*rp)->len)
+	    return rp;
+    fprintf(stderr, "ERROR: %p is not a region from mem_map...\n", lo);
+    exit(1);
+}
+
+/*
+ * mem_unmap - give back the region from mem_map that holds lo
+ */
+void mem_unmap(void *lo)
+{
+    mem_region_t **rp = mem_region(lo);
+    mem_region_t *r = *rp;
+
+    munmap(r->lo, r->len);
+    mem->mapped -= r->len;
+    *rp = r->next;
+    free(r);
+}
+
+/*
+ * mem_remap - grow or shrink the region that holds lo so that at least
+ *    len bytes follow lo, moving it if need be, and return lo's new
+ *    address (NULL, with the region left alone, if it cannot be
+ *    resized). Pages it gains read as zero.
+ */
+void *mem_remap(void *lo, size_t len)
+{
+    mem_region_t *r = *mem_region(lo);
+    size_t off = (char *)lo - r->lo;
+    char *p;
+
+    len = (size_t)PAGE_UP(off + len);
+    if (len == 0)
+	return NULL;
+    if ((p = mremap(r->lo, r->len, len, MREMAP_MAYMOVE)) == MAP_FAILED) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    mem->mapped = mem->mapped - r->len + len;
+    r->lo = p;
+    r->len = len;
+    mem_note_peak();
+    return p + off;
+}
+
+/*
+ * mem_in_region - return whether [lo, lo+len) lies inside one region
+ */
+int mem_in_region(const void *lo, size_t len)
+{
+    mem_region_t *r;
+
+    for (r = mem->regions; r != NULL; r = r->next)
+	if ((const char *)lo >= r->lo && (const char *)lo + len <= r->lo + r->len)
+	    return 1;
+    return 0;
+}
+
+/*
+ * mem_unmap_all - give back every region mem_map handed out
+ */
+static void mem_unmap_all(void)
+{
+    while (mem->regions != NULL)
+	mem_unmap(mem->regions->lo);
+}
+
+/*
+ * mem_note_peak - raise the footprint high-water mark to the heap plus
+ *    the regions now mapped
+ */
+static void mem_note_peak(void)
+{
+    size_t fp = (size_t)(mem->brk - mem->heap) + mem->mapped;
+
+    if (fp > mem->peak_fp)
+	mem->peak_fp = fp;
+}
+
+/*
+ * mem_purge - give the whole pages inside [lo, lo+len) back to the OS.
+ *    They stay mapped, read as zero, and are not resident until touched.
+ */
+void mem_purge(void *lo, size_t len)
+{
+    char *start = PAGE_UP(lo);
+    char *end = PAGE_DOWN((char *)lo + len);
+
+    if (end <= start)
+	return;
+    madvise(start, end - start, MADV_DONTNEED);
+
+    /* purged pages above the brk need no clearing when handed out */
+    if (end >= mem->dirty && start <= PAGE_UP(mem->brk))
+	mem->dirty = (start > mem->brk) ? start : PAGE_UP(mem->brk);
+}
+
+/*
+ * resident - return the number of bytes in the pages of [lo, lo+len)
+ *    that are resident in memory
+ */
+static size_t resident(char *lo, size_t len)
+{
+    static unsigned char vec[MAX_HEAP / 4096 + 1];
+    size_t chunk, i, n = 0;
+
+    if (mem_page < 4096)
+	return 0;
+    for ( ; len > 0; lo += chunk, len -= chunk) {
+	chunk = len < MAX_HEAP ? len : MAX_HEAP;
+	if (mincore(lo, chunk, vec) < 0)
+	    return 0;
+	for (i = 0; i < (chunk + mem_page - 1) / mem_page; i++)
+	    n += vec[i] & 1;
+    }
+    return n * mem_page;
+}
+
+/*
+ * mem_resident - return the number of heap bytes (below the brk) and
+ *    mapped region bytes that are resident in memory
+ */
+size_t mem_resident()
+{
+    mem_region_t *r;
+    size_t n = resident(mem->heap, PAGE_UP(mem->brk) - mem->heap);
+
+    for (r = mem->regions; r != NULL; r = r->next)
+	n += resident(r->lo, r->len);
+    return n;
+}
+
+/*
+ * mem_clean_lo - return the address from which the heap, up to MAX_HEAP,
+ *    reads as zero: memory never handed out, or given back with a
+ *    negative mem_sbrk. Memory handed out before a mem_reset_brk is not
+ *    clean.
+ */
+void *mem_clean_lo(void)
+{
+    return (void *)mem->dirty;
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
 void *mem_heap_lo()
 {
-    return (void *)heap;
+    return (void *)mem->heap;
 }
 
 /* 
@@ -74,7 +394,7 @@ void *mem_heap_lo()
  */
 void *mem_heap_hi()
 {
-    return (void *)(mem_brk - 1);
+    return (void *)(mem->brk - 1);
 }
 
 /*
@@ -82,7 +402,33 @@ void *mem_heap_hi()
  */
 size_t mem_heapsize() 
 {
-    return (size_t)((void *)mem_brk - (void *)heap);
+    return (size_t)((void *)mem->brk - (void *)mem->heap);
+}
+
+/*
+ * mem_peak_heapsize() - returns the largest the heap has been, in bytes,
+ *    since the last reset
+ */
+size_t mem_peak_heapsize() 
+{
+    return (size_t)((void *)mem->peak - (void *)mem->heap);
+}
+
+/*
+ * mem_mapsize() - returns the bytes mapped by mem_map
+ */
+size_t mem_mapsize()
+{
+    return mem->mapped;
+}
+
+/*
+ * mem_peak_footprint() - returns the largest the heap and the mapped
+ *    regions have been together, in bytes, since the last reset
+ */
+size_t mem_peak_footprint()
+{
+    return mem->peak_fp;
 }
 
 /*
@@ -1,11 +1,30 @@
+#include <stdint.h>
 #include <unistd.h>
 
 void mem_init(void);               
 void mem_deinit(void);
-void *mem_sbrk(int incr);
+void *mem_sbrk(intptr_t incr);
 void mem_reset_brk(void); 
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
 size_t mem_heapsize(void);
+size_t mem_peak_heapsize(void);
+void *mem_map(size_t len);
+void mem_unmap(void *lo);
+void *mem_remap(void *lo, size_t len);
+int mem_in_region(const void *lo, size_t len);
+size_t mem_mapsize(void);
+size_t mem_peak_footprint(void);
+void mem_purge(void *lo, size_t len);
+void *mem_clean_lo(void);
+size_t mem_resident(void);
 size_t mem_pagesize(void);
 
+/* Further memory systems, each with a heap of its own. mem_use(m) makes
+   the calls above work on m (the default if NULL) in the calling thread
+   and returns the one they worked on before. */
+typedef struct mem_heap mem_heap_t;
+mem_heap_t *mem_create(void);
+void mem_destroy(mem_heap_t *m);
+mem_heap_t *mem_use(mem_heap_t *m);
+
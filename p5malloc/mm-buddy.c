@@ -0,0 +1,583 @@
+/*
+ * mm-buddy.c - Binary buddy allocator, for comparison with mm.c.
+ *
+ * The heap is an arena of 2^top bytes, split into blocks whose sizes are
+ * powers of two from MIN_BLOCK up. A block of order k (2^k bytes) starts
+ * at an offset that is a multiple of 2^k, and its buddy is the block
+ * whose offset differs from it only in bit k, so splitting and merging
+ * are a matter of XOR. A request is rounded up to a power of two; the
+ * smallest free block that fits is halved until it is the right size,
+ * and a freed block is merged with its buddy for as long as the buddy is
+ * free too. Either way that takes at most MAX_ORDER - MIN_ORDER steps.
+ *
+ * Nothing is kept inside a free block. Which blocks are free is recorded
+ * in a bitmap per order, with two levels of summary bits above it, so the
+ * lowest free block of an order is found with three word scans. The order
+ * of each allocated block is kept in order_map, one byte per MIN_BLOCK of
+ * the arena, so a block needs no header and a request of 2^k bytes gets
+ * a block of exactly 2^k. Since free blocks take no memory, brk only has
+ * to reach the end of the highest block ever allocated: the arena doubles
+ * on paper when it is full, but memlib is only asked for what is used.
+ * That lets MAX_ORDER go past MAX_HEAP: a request fails only when its
+ * block would end beyond what memlib can give.
+ *
+ * mm_trim purges every free block, none of which holds anything, and
+ * lowers brk to the end of the highest allocated block. Arenas, pools,
+ * heaps and mm_mallopt knobs are not supported: their calls fail, and
+ * mdriver stops with an error in the modes that need them. Not thread
+ * safe.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "config.h"
+
+#define MIN_ORDER   4                    /* smallest block: 16 bytes */
+#define MAX_ORDER   25                   /* largest arena: 32 MB */
+#define ORDERS      (MAX_ORDER - MIN_ORDER + 1)
+#define MIN_BLOCK   (1UL << MIN_ORDER)
+#define START_ORDER 12                   /* arena size after mm_init */
+
+/* Words in the free bitmap of order k, and in its two summary levels */
+#define BITS(k)     (1UL << (MAX_ORDER - (k)))
+#define WORDS(n)    (((n) + 63) / 64)
+#define MAP0_WORDS  (2 * WORDS(BITS(MIN_ORDER)) + ORDERS)
+#define MAP1_WORDS  (2 * WORDS(WORDS(BITS(MIN_ORDER))) + ORDERS)
+#define MAP2_WORDS  (2 * WORDS(WORDS(WORDS(BITS(MIN_ORDER)))) + ORDERS)
+
+/* order_map entry of a payload that memalign placed inside its block */
+#define INTERIOR    0xff
+/* so the block starts at the address in the word before the payload */
+#define BLOCK_OF(p) (*(char **)((char *)(p) - sizeof(char *)))
+
+static char *base;                       /* offset 0 of the arena */
+static int top;                          /* the arena is 2^top bytes */
+static unsigned long map0[MAP0_WORDS];   /* bit set = block free */
+static unsigned long map1[MAP1_WORDS];   /* bit set = map0 word not 0 */
+static unsigned long map2[MAP2_WORDS];   /* bit set = map1 word not 0 */
+static unsigned long *free0[ORDERS], *free1[ORDERS], *free2[ORDERS];
+static unsigned char order_map[BITS(MIN_ORDER)];
+static mm_stats_t stats;
+
+/* function prototypes for internal helper routines */
+static int order_of(size_t size);
+static int is_free(int k, size_t i);
+static void set_free(int k, size_t i);
+static void clr_free(int k, size_t i);
+static long find_free(int k);
+static void release(int k, size_t i);
+static char *alloc_order(int k);
+static int grow(void);
+static int cover(char *end);
+static char *block_start(void *ptr, int *k);
+
+/*
+ * mm_init - Start an empty arena of 2^START_ORDER bytes
+ */
+int mm_init(void)
+{
+  unsigned long *p0 = map0, *p1 = map1, *p2 = map2;
+  size_t pad;
+  int k;
+
+  memset(map0, 0, sizeof(map0));
+  memset(map1, 0, sizeof(map1));
+  memset(map2, 0, sizeof(map2));
+  for (k = MIN_ORDER; k <= MAX_ORDER; k++) {
+    free0[k - MIN_ORDER] = p0;
+    free1[k - MIN_ORDER] = p1;
+    free2[k - MIN_ORDER] = p2;
+    p0 += WORDS(BITS(k));
+    p1 += WORDS(WORDS(BITS(k)));
+    p2 += WORDS(WORDS(WORDS(BITS(k))));
+  }
+  if (base != NULL && top > 0)
+    memset(order_map, 0, (1UL << top) >> MIN_ORDER);
+
+  /* a page-aligned base makes every block of up to a page aligned too */
+  if ((base = mem_sbrk(0)) == (void *)-1)
+    return -1;
+  pad = -(size_t)base & (mem_pagesize() - 1);
+  if (pad > 0 && (base = mem_sbrk(pad)) == (void *)-1)
+    return -1;
+  base += pad;
+
+  top = START_ORDER;
+  set_free(top, 0);
+  memset(&stats, 0, sizeof(stats));
+  return 0;
+}
+
+/*
+ * malloc - Allocate a block of the smallest order that holds size bytes
+ */
+void *mm_malloc(size_t size)
+{
+  int k;
+
+  if (base == NULL)
+    mm_init();
+  if (size == 0 || (k = order_of(size)) < 0)
+    return NULL;
+  return alloc_order(k);
+}
+
+/*
+ * free - Free a block and merge it with its buddies
+ */
+void mm_free(void *ptr)
+{
+  char *bp;
+  int k;
+
+  if (ptr == NULL)
+    return;
+  bp = block_start(ptr, &k);
+  order_map[((char *)ptr - base) >> MIN_ORDER] = 0;
+  order_map[(bp - base) >> MIN_ORDER] = 0;
+  release(k, (bp - base) >> k);
+}
+
+/*
+ * realloc - Keep the block if it is already the right order, hand back
+ *     its upper halves if it is bigger than needed, and take in its free
+ *     upper buddies if they make it big enough; otherwise move it.
+ */
+void *mm_realloc(void *ptr, size_t size)
+{
+  char *bp, *newptr;
+  size_t i, old;
+  int k, j, want;
+
+  if (ptr == NULL)
+    return mm_malloc(size);
+  if (size == 0) {
+    mm_free(ptr);
+    return NULL;
+  }
+  if ((want = order_of(size)) < 0)
+    return NULL;
+  bp = block_start(ptr, &k);
+  old = mm_usable_size(ptr);
+  if ((char *)ptr == bp) {
+    i = (bp - base) >> k;
+    if (want <= k) {
+      for ( ; k > want; k--) {
+        i *= 2;
+        release(k - 1, i + 1);
+      }
+      order_map[(bp - base) >> MIN_ORDER] = k;
+      stats.copies_avoided++;
+      stats.avoided_bytes += size;
+      return ptr;
+    }
+    /* the block keeps its start only while it is the lower buddy */
+    for (j = k; j < want && j < top && !(i & 1) && is_free(j, i ^ 1); j++)
+      i >>= 1;
+    if (j == want && cover(bp + (1UL << want))) {
+      for (i = (bp - base) >> k; k < want; k++, i >>= 1)
+        clr_free(k, i ^ 1);
+      order_map[(bp - base) >> MIN_ORDER] = want;
+      stats.copies_avoided++;
+      stats.avoided_bytes += old;
+      return ptr;
+    }
+  }
+
+  if ((newptr = mm_malloc(size)) == NULL)
+    return NULL;
+  memcpy(newptr, ptr, old < size ? old : size);
+  stats.realloc_copies++;
+  stats.copied_bytes += old < size ? old : size;
+  mm_free(ptr);
+  return newptr;
+}
+
+/*
+ * calloc - Allocate the block and clear it
+ */
+void *mm_calloc(size_t nmemb, size_t size)
+{
+  size_t bytes = nmemb * size;
+  void *newptr;
+
+  if (nmemb != 0 && bytes / nmemb != size)
+    return NULL;
+  if ((newptr = mm_malloc(bytes)) != NULL)
+    memset(newptr, 0, bytes);
+  return newptr;
+}
+
+/*
+ * memalign - A block of order at least log2(alignment) is aligned to it
+ *     as long as that is no more than the page the arena starts on.
+ *     Beyond that, take a block with room for the alignment and point
+ *     into it, leaving the block's address just before the payload.
+ */
+void *mm_memalign(size_t alignment, size_t size)
+{
+  char *bp, *p;
+
+  if (alignment == 0 || (alignment & (alignment - 1)))
+    return NULL;
+  if (alignment <= mem_pagesize())
+    return mm_malloc(size > alignment ? size : alignment);
+  if ((bp = mm_malloc(size + alignment)) == NULL)
+    return NULL;
+  p = (char *)(((size_t)bp + alignment - 1) & ~(alignment - 1));
+  if (p == bp)
+    return p;
+  BLOCK_OF(p) = bp;
+  order_map[(p - base) >> MIN_ORDER] = INTERIOR;
+  return p;
+}
+
+void *mm_aligned_alloc(size_t alignment, size_t size)
+{
+  return mm_memalign(alignment, size);
+}
+
+int mm_posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+  void *p;
+
+  if (alignment < sizeof(void *) || (alignment & (alignment - 1)))
+    return EINVAL;
+  if ((p = mm_memalign(alignment, size)) == NULL && size != 0)
+    return ENOMEM;
+  *memptr = p;
+  return 0;
+}
+
+/*
+ * usable_size - The rest of the block from ptr on
+ */
+size_t mm_usable_size(void *ptr)
+{
+  char *bp;
+  int k;
+
+  if (ptr == NULL)
+    return 0;
+  bp = block_start(ptr, &k);
+  return (1UL << k) - ((char *)ptr - bp);
+}
+
+void mm_free_sized(void *ptr, size_t size)
+{
+  (void)size;
+  mm_free(ptr);
+}
+
+/*
+ * good_size - The block size a request of size bytes is rounded up to
+ */
+size_t mm_good_size(size_t size)
+{
+  int k = order_of(size);
+
+  return k < 0 ? size : 1UL << k;
+}
+
+size_t mm_malloc_batch(size_t size, size_t n, void **out)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    if ((out[i] = mm_malloc(size)) == NULL)
+      break;
+  return i;
+}
+
+void mm_free_batch(void **ptrs, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    mm_free(ptrs[i]);
+}
+
+/*
+ * Not supported by this allocator
+ */
+mm_arena_t *mm_arena_create(size_t chunk) { (void)chunk; return NULL; }
+void *mm_arena_alloc(mm_arena_t *arena, size_t size)
+{ (void)arena; (void)size; return NULL; }
+void mm_arena_reset(mm_arena_t *arena) { (void)arena; }
+void mm_arena_destroy(mm_arena_t *arena) { (void)arena; }
+
+mm_pool_t *mm_pool_create(size_t obj_size, size_t align)
+{ (void)obj_size; (void)align; return NULL; }
+void *mm_pool_alloc(mm_pool_t *pool) { (void)pool; return NULL; }
+void mm_pool_free(mm_pool_t *pool, void *ptr) { (void)pool; (void)ptr; }
+int mm_pool_reserve(mm_pool_t *pool, size_t n) { (void)pool; (void)n; return 0; }
+size_t mm_pool_release(mm_pool_t *pool) { (void)pool; return 0; }
+void mm_pool_destroy(mm_pool_t *pool) { (void)pool; }
+
+mm_heap_t *mm_heap_create(void) { return NULL; }
+void mm_heap_destroy(mm_heap_t *heap) { (void)heap; }
+mm_heap_t *mm_heap_use(mm_heap_t *heap) { (void)heap; return NULL; }
+void *mm_heap_malloc(mm_heap_t *heap, size_t size)
+{ (void)heap; return mm_malloc(size); }
+void mm_heap_free(mm_heap_t *heap, void *ptr) { (void)heap; mm_free(ptr); }
+void *mm_heap_realloc(mm_heap_t *heap, void *ptr, size_t size)
+{ (void)heap; return mm_realloc(ptr, size); }
+void *mm_heap_calloc(mm_heap_t *heap, size_t nmemb, size_t size)
+{ (void)heap; return mm_calloc(nmemb, size); }
+
+int mm_mallopt(int param, int value) { (void)param; (void)value; return 0; }
+
+/*
+ * trim - Purge the pages inside every free block below brk, then lower
+ *     brk to pad bytes past the end of the highest allocated block
+ */
+int mm_trim(size_t pad)
+{
+  char *brk = (char *)mem_heap_hi() + 1, *lo, *hi, *end = base;
+  unsigned long bits;
+  size_t g, w, i;
+  int k;
+
+  if (base == NULL)
+    return 0;
+  for (k = MIN_ORDER; k <= top; k++)
+    for (w = 0; w < WORDS(1UL << (top - k)); w++)
+      for (bits = free0[k - MIN_ORDER][w]; bits != 0; bits &= bits - 1) {
+        i = w * 64 + __builtin_ctzl(bits);
+        lo = base + (i << k);
+        hi = lo + (1UL << k) < brk ? lo + (1UL << k) : brk;
+        if (lo >= brk)
+          continue;
+        mem_purge(lo, hi - lo);
+        lo = (char *)(((size_t)lo + mem_pagesize() - 1) & ~(mem_pagesize() - 1));
+        hi = (char *)((size_t)hi & ~(mem_pagesize() - 1));
+        if (hi > lo)
+          stats.purged_bytes += hi - lo;
+      }
+
+  /* blocks are disjoint, so the one starting highest also ends highest */
+  for (g = (brk - base) >> MIN_ORDER; g-- > 0; )
+    if (order_map[g] != 0 && order_map[g] != INTERIOR) {
+      end = base + (g << MIN_ORDER) + (1UL << order_map[g]);
+      break;
+    }
+  if (end + pad >= brk)
+    return 0;
+  return mem_sbrk(-(intptr_t)(brk - (end + pad))) != (void *)-1;
+}
+
+void mm_get_stats(mm_stats_t *out)
+{
+  *out = stats;
+}
+
+/**********************************************************************/
+// Blocks and orders
+
+/*
+ * order_of - The order of the smallest block of at least size bytes,
+ *     or -1 if even the largest arena is too small
+ */
+static int order_of(size_t size)
+{
+  int k;
+
+  if (size > (1UL << MAX_ORDER))
+    return -1;
+  if (size <= MIN_BLOCK)
+    return MIN_ORDER;
+  k = 64 - __builtin_clzl(size - 1);
+  return k;
+}
+
+/*
+ * alloc_order - Take the lowest free block of the smallest order from
+ *     k up, halving it down to order k, and growing the arena if no
+ *     order has one
+ */
+static char *alloc_order(int k)
+{
+  long i;
+  int j;
+  char *bp;
+
+  for (;;) {
+    for (j = k; j <= top; j++)
+      if ((i = find_free(j)) >= 0)
+        break;
+    if (j <= top)
+      break;
+    if (!grow())
+      return NULL;
+  }
+
+  /* the lower half goes on down, the upper half stays free */
+  clr_free(j, i);
+  for ( ; j > k; j--) {
+    i *= 2;
+    set_free(j - 1, i + 1);
+  }
+  bp = base + ((size_t)i << k);
+  if (!cover(bp + (1UL << k))) {
+    release(k, i);
+    return NULL;
+  }
+  order_map[(bp - base) >> MIN_ORDER] = k;
+  return bp;
+}
+
+/*
+ * release - Free block i of order k, merging it with its buddy for as
+ *     long as that is free
+ */
+static void release(int k, size_t i)
+{
+  while (k < top && is_free(k, i ^ 1)) {
+    clr_free(k, i ^ 1);
+    i >>= 1;
+    k++;
+  }
+  set_free(k, i);
+}
+
+/*
+ * grow - Double the arena: the new upper half is one free block, the
+ *     buddy of the old arena. Returns 0 if the arena is at MAX_ORDER.
+ */
+static int grow(void)
+{
+  if (top == MAX_ORDER)
+    return 0;
+  top++;
+  release(top - 1, 1);
+  return 1;
+}
+
+/*
+ * cover - Move brk up to end if it is not there yet. Returns 0 if
+ *     memlib is out of memory.
+ */
+static int cover(char *end)
+{
+  char *brk = (char *)mem_heap_hi() + 1;
+
+  if (end <= brk)
+    return 1;
+  return mem_sbrk(end - brk) != (void *)-1;
+}
+
+/*
+ * block_start - The start and order (in *k) of the allocated block that
+ *     holds the payload ptr
+ */
+static char *block_start(void *ptr, int *k)
+{
+  char *bp = ptr;
+
+  if (order_map[(bp - base) >> MIN_ORDER] == INTERIOR)
+    bp = BLOCK_OF(ptr);
+  *k = order_map[(bp - base) >> MIN_ORDER];
+  return bp;
+}
+
+/**********************************************************************/
+// Free bitmaps: bit i of order k's bitmap says whether block i is free
+
+static int is_free(int k, size_t i)
+{
+  return (free0[k - MIN_ORDER][i / 64] >> (i % 64)) & 1;
+}
+
+static void set_free(int k, size_t i)
+{
+  free0[k - MIN_ORDER][i / 64] |= 1UL << (i % 64);
+  free1[k - MIN_ORDER][i / 4096] |= 1UL << (i / 64 % 64);
+  free2[k - MIN_ORDER][i / 262144] |= 1UL << (i / 4096 % 64);
+}
+
+static void clr_free(int k, size_t i)
+{
+  unsigned long *w0 = &free0[k - MIN_ORDER][i / 64];
+  unsigned long *w1 = &free1[k - MIN_ORDER][i / 4096];
+
+  if ((*w0 &= ~(1UL << (i % 64))) != 0)
+    return;
+  if ((*w1 &= ~(1UL << (i / 64 % 64))) != 0)
+    return;
+  free2[k - MIN_ORDER][i / 262144] &= ~(1UL << (i / 4096 % 64));
+}
+
+/*
+ * find_free - The lowest free block of order k, or -1 if there is none
+ */
+static long find_free(int k)
+{
+  unsigned long *w2 = free2[k - MIN_ORDER];
+  size_t n2 = WORDS(WORDS(WORDS(BITS(k))));
+  size_t a, b, c;
+
+  for (a = 0; a < n2 && w2[a] == 0; a++)
+    ;
+  if (a == n2)
+    return -1;
+  b = a * 64 + __builtin_ctzl(w2[a]);
+  c = b * 64 + __builtin_ctzl(free1[k - MIN_ORDER][b]);
+  return c * 64 + __builtin_ctzl(free0[k - MIN_ORDER][c]);
+}
+
+/**********************************************************************/
+// Printing and checking helpers for debugging
+
+/*
+ * checkheap - Walk the arena block by block: each must be allocated or
+ *     free at exactly one order, and no two free buddies may be left
+ *     unmerged. The summary bits must match the bitmaps below them.
+ */
+void mm_checkheap(int verbose)
+{
+  size_t off, end = (size_t)1 << top, w;
+  unsigned long *m0, *m1;
+  int k, j, found;
+
+  for (off = 0; off < end; off += (size_t)1 << k) {
+    k = order_map[off >> MIN_ORDER];
+    if (k == INTERIOR) {
+      printf("Error: aligned payload %p is not inside a block\n", base + off);
+      return;
+    }
+    found = 0;
+    for (j = MIN_ORDER; j <= top; j++)
+      if (!(off & (((size_t)1 << j) - 1)) && is_free(j, off >> j)) {
+        if (found || k)
+          printf("Error: block at %p is free twice over\n", base + off);
+        found = 1;
+        k = j;
+      }
+    if (!k) {
+      printf("Error: offset %zu of the arena is in no block\n", off);
+      return;
+    }
+    if (found && k < top && is_free(k, (off >> k) ^ 1))
+      printf("Error: free block %p and its buddy are not merged\n", base + off);
+    if (verbose)
+      printf("%p: %s order %d\n", base + off, found ? "free" : "allocated", k);
+  }
+
+  for (k = MIN_ORDER; k <= MAX_ORDER; k++) {
+    m0 = free0[k - MIN_ORDER];
+    m1 = free1[k - MIN_ORDER];
+    for (w = 0; w < WORDS(BITS(k)); w++)
+      if (!m0[w] != !((m1[w / 64] >> (w % 64)) & 1))
+        printf("Error: summary bit for order %d word %zu is wrong\n", k, w);
+    for (w = 0; w < WORDS(WORDS(BITS(k))); w++)
+      if (!m1[w] != !((free2[k - MIN_ORDER][w / 64] >> (w % 64)) & 1))
+        printf("Error: top summary bit for order %d word %zu is wrong\n", k, w);
+  }
+}
@@ -0,0 +1,722 @@
+/*
+ * mm-oob.c - Segregated fit with every tag and link out of band.
+ *
+ * mm.c keeps its boundary tags and free-list links in the heap, next to
+ * and inside the payloads, so the allocator's bookkeeping shares cache
+ * lines and pages with the application's data. Here the heap holds
+ * nothing but payloads. The heap is cut into granules of ALIGNMENT
+ * bytes, and the rest lives in two tables outside it:
+ *
+ *   map      two bits per granule: start, set on the first granule of
+ *            each block and on the granule just past the heap, and used,
+ *            set on the first granule of each allocated block. A block
+ *            runs up to the next start bit.
+ *   recs     a 16-byte record for each free block only, holding its first
+ *            granule, its length and its free-list links, with an open
+ *            addressing hash from first granule to record
+ *
+ * Free blocks are kept on CLASSES lists by the log2 of their length
+ * and found by first fit, and freed blocks are coalesced right away, as
+ * in mm.c. malloc and free never read or write a payload. Since a
+ * block needs no room for tags or links, the smallest block is one
+ * granule, and a block is split whenever it is a granule too big.
+ * mm_trim can purge every whole page inside every free block, with no
+ * tags or links in them to keep.
+ *
+ * Both tables share one region from mem_map, grown with mem_remap as the
+ * heap and the number of free blocks grow, so mdriver counts them in the
+ * footprint like the heap itself. The smallest heap still pays a page
+ * for them.
+ *
+ * Arenas, pools, heaps and mm_mallopt knobs are not supported; their
+ * calls fail or do nothing. Not thread safe.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "config.h"
+
+#define GRAIN       ALIGNMENT             /* bytes per granule */
+#define CLASSES     12                    /* lengths 1, 2-3, ... 2048 and up */
+#define INIT_RECS   64                    /* records in the first table */
+
+/* Read and write the bits of granule g */
+#define BIT(g)      ((uint64_t)1 << ((g) & 63))
+#define START(g)    (map[(g) >> 6].start & BIT(g))
+#define USED(g)     (map[(g) >> 6].used & BIT(g))
+#define SET_START(g) (map[(g) >> 6].start |= BIT(g))
+#define CLR_START(g) (map[(g) >> 6].start &= ~BIT(g))
+#define SET_USED(g) (map[(g) >> 6].used |= BIT(g))
+#define CLR_USED(g) (map[(g) >> 6].used &= ~BIT(g))
+
+/* Home slot of granule g in the hash */
+#define HASH(g)     ((uint32_t)((g) * 2654435761u) >> hshift)
+
+/* Granule numbers and payload addresses */
+#define GRAIN_OF(p) ((uint32_t)(((char *)(p) - base) / GRAIN))
+#define PAYLOAD(g)  (base + (size_t)(g) * GRAIN)
+
+/* The bits of 64 granules */
+typedef struct {
+  uint64_t start, used;
+} word_t;
+
+/* A free block. next and prev are record numbers plus one (0 is the end
+   of a list); a record that holds no block has len 0 and is on the list
+   of spare records through next. */
+typedef struct {
+  uint32_t g, len;
+  uint32_t next, prev;
+} rec_t;
+
+static char *base;                        /* granule 0 */
+static uint32_t grains;                   /* granules in the heap */
+static rec_t *recs;                       /* free-block records, and the tables */
+static uint32_t *slots;                   /* hash of record numbers + 1 */
+static word_t *map;                       /* start and used bits */
+static size_t mapwords;                   /* words of bits in map */
+static uint32_t cap, live, used_recs;     /* records: room, free blocks, touched */
+static uint32_t spare;                    /* first spare record + 1 */
+static int hshift;                        /* 32 - log2 of the slots */
+static uint32_t heads[CLASSES];           /* first record of each list + 1 */
+static mm_stats_t stats;
+
+/* function prototypes for internal helper routines */
+static uint32_t grains_for(size_t size);
+static int class_of(uint32_t len);
+static uint32_t next_start(uint32_t g);
+static uint32_t start_of(uint32_t g);
+static int grow_tables(uint32_t newcap, size_t words);
+static int map_room(uint32_t n);
+static int rec_room(uint32_t n);
+static uint32_t *slot_of(uint32_t g);
+static void insert_free(uint32_t g, uint32_t len);
+static uint32_t remove_free(uint32_t g);
+static void free_block(uint32_t g, uint32_t len);
+static void place(uint32_t g, uint32_t asize);
+static long find_fit(uint32_t asize);
+static long extend_heap(uint32_t asize);
+
+/*
+ * mm_init - Start an empty heap. The tables are mapped on first use.
+ */
+int mm_init(void)
+{
+  if ((base = mem_sbrk(0)) == (void *)-1)
+    return -1;
+  grains = 0;
+  recs = NULL;
+  slots = NULL;
+  map = NULL;
+  mapwords = 0;
+  cap = live = used_recs = spare = 0;
+  memset(heads, 0, sizeof(heads));
+  memset(&stats, 0, sizeof(stats));
+  return 0;
+}
+
+/*
+ * malloc - First fit from the size class of the request up, or new
+ *     granules at the end of the heap
+ */
+void *mm_malloc(size_t size)
+{
+  uint32_t asize;
+  long g;
+
+  if (base == NULL)
+    mm_init();
+  if (size == 0 || (asize = grains_for(size)) == 0 || rec_room(1) < 0)
+    return NULL;
+  if ((g = find_fit(asize)) < 0 && (g = extend_heap(asize)) < 0)
+    return NULL;
+  place(g, asize);
+  return PAYLOAD(g);
+}
+
+/*
+ * free - Free a block and coalesce it with its free neighbors. If no
+ *     record can be had for it, the block stays allocated.
+ */
+void mm_free(void *ptr)
+{
+  uint32_t g;
+
+  if (ptr == NULL || rec_room(1) < 0)
+    return;
+  g = GRAIN_OF(ptr);
+  free_block(g, next_start(g) - g);
+}
+
+/*
+ * realloc - Shrink in place, grow into a free block that follows or
+ *     past the end of the heap, and move the block only if neither works
+ */
+void *mm_realloc(void *ptr, size_t size)
+{
+  uint32_t g, len, asize, more;
+  void *newptr;
+
+  if (ptr == NULL)
+    return mm_malloc(size);
+  if (size == 0) {
+    mm_free(ptr);
+    return NULL;
+  }
+  if ((asize = grains_for(size)) == 0 || rec_room(1) < 0)
+    return NULL;
+  g = GRAIN_OF(ptr);
+  len = next_start(g) - g;
+
+  if (asize > len && g + len < grains && !USED(g + len) &&
+      len + recs[*slot_of(g + len) - 1].len >= asize) {
+    CLR_START(g + len);
+    len += remove_free(g + len);
+  } else if (asize > len && g + len == grains) {
+    more = asize - len;
+    if (map_room(grains + more) < 0 ||
+        mem_sbrk((size_t)more * GRAIN) == (void *)-1)
+      return NULL;
+    CLR_START(grains);
+    grains += more;
+    SET_START(grains);
+    len = asize;
+  }
+  if (asize <= len) {
+    if (len > asize)
+      free_block(g + asize, len - asize);
+    stats.copies_avoided++;
+    stats.avoided_bytes += (size_t)asize * GRAIN;
+    return ptr;
+  }
+
+  if ((newptr = mm_malloc(size)) == NULL)
+    return NULL;
+  memcpy(newptr, ptr, (size_t)len * GRAIN);
+  stats.realloc_copies++;
+  stats.copied_bytes += (size_t)len * GRAIN;
+  mm_free(ptr);
+  return newptr;
+}
+
+/*
+ * calloc - Allocate the block and clear it
+ */
+void *mm_calloc(size_t nmemb, size_t size)
+{
+  size_t bytes = nmemb * size;
+  void *newptr;
+
+  if (nmemb != 0 && bytes / nmemb != size)
+    return NULL;
+  if ((newptr = mm_malloc(bytes)) != NULL)
+    memset(newptr, 0, bytes);
+  return newptr;
+}
+
+/*
+ * memalign - Allocate enough for an aligned payload anywhere in the
+ *     block, then free the granules before and after it. Any number of
+ *     granules makes a block, so nothing is too small to give back.
+ */
+void *mm_memalign(size_t alignment, size_t size)
+{
+  uint32_t g, len, asize, front;
+  char *p;
+
+  if (alignment == 0 || (alignment & (alignment - 1)))
+    return NULL;
+  if (alignment <= GRAIN)
+    return mm_malloc(size);
+  if (size == 0 || (asize = grains_for(size)) == 0 || rec_room(3) < 0 ||
+      (p = mm_malloc(size + alignment - GRAIN)) == NULL)
+    return NULL;
+
+  g = GRAIN_OF(p);
+  len = next_start(g) - g;
+  front = GRAIN_OF((char *)(((size_t)p + alignment - 1) & ~(alignment - 1))) - g;
+  if (front > 0) {
+    SET_START(g + front);
+    SET_USED(g + front);
+    free_block(g, front);
+    g += front;
+    len -= front;
+  }
+  if (len > asize)
+    free_block(g + asize, len - asize);
+  return PAYLOAD(g);
+}
+
+void *mm_aligned_alloc(size_t alignment, size_t size)
+{
+  return mm_memalign(alignment, size);
+}
+
+int mm_posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+  void *p;
+
+  if (alignment < sizeof(void *) || (alignment & (alignment - 1)))
+    return EINVAL;
+  if ((p = mm_memalign(alignment, size)) == NULL && size != 0)
+    return ENOMEM;
+  *memptr = p;
+  return 0;
+}
+
+/*
+ * usable_size - The whole block: no part of it holds a tag
+ */
+size_t mm_usable_size(void *ptr)
+{
+  uint32_t g;
+
+  if (ptr == NULL)
+    return 0;
+  g = GRAIN_OF(ptr);
+  return (size_t)(next_start(g) - g) * GRAIN;
+}
+
+void mm_free_sized(void *ptr, size_t size)
+{
+  (void)size;
+  mm_free(ptr);
+}
+
+/*
+ * good_size - A request of size bytes gets whole granules
+ */
+size_t mm_good_size(size_t size)
+{
+  return (size + GRAIN - 1) & ~(size_t)(GRAIN - 1);
+}
+
+size_t mm_malloc_batch(size_t size, size_t n, void **out)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    if ((out[i] = mm_malloc(size)) == NULL)
+      break;
+  return i;
+}
+
+void mm_free_batch(void **ptrs, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    mm_free(ptrs[i]);
+}
+
+/*
+ * trim - Purge the pages inside every free block, then give back all
+ *     but pad bytes of a free block at the end of the heap
+ */
+int mm_trim(size_t pad)
+{
+  uint32_t g, len, keep, r;
+  char *lo, *hi;
+  int c;
+
+  for (c = 0; c < CLASSES; c++)
+    for (r = heads[c]; r != 0; r = recs[r - 1].next) {
+      lo = PAYLOAD(recs[r - 1].g);
+      hi = lo + (size_t)recs[r - 1].len * GRAIN;
+      mem_purge(lo, hi - lo);
+      lo = (char *)(((size_t)lo + mem_pagesize() - 1) & ~(mem_pagesize() - 1));
+      hi = (char *)((size_t)hi & ~(mem_pagesize() - 1));
+      if (hi > lo)
+        stats.purged_bytes += hi - lo;
+    }
+
+  if (grains == 0)
+    return 0;
+  g = start_of(grains - 1);
+  if (USED(g))
+    return 0;
+  len = grains - g;
+  keep = grains_for(pad);
+  if (keep >= len)
+    return 0;
+  remove_free(g);
+  mem_sbrk(-(intptr_t)(len - keep) * GRAIN);
+  CLR_START(grains);
+  grains -= len - keep;
+  SET_START(grains);
+  if (keep > 0)
+    free_block(g, keep);
+  return 1;
+}
+
+/*
+ * Not supported by this allocator
+ */
+mm_arena_t *mm_arena_create(size_t chunk) { (void)chunk; return NULL; }
+void *mm_arena_alloc(mm_arena_t *arena, size_t size)
+{ (void)arena; (void)size; return NULL; }
+void mm_arena_reset(mm_arena_t *arena) { (void)arena; }
+void mm_arena_destroy(mm_arena_t *arena) { (void)arena; }
+
+mm_pool_t *mm_pool_create(size_t obj_size, size_t align)
+{ (void)obj_size; (void)align; return NULL; }
+void *mm_pool_alloc(mm_pool_t *pool) { (void)pool; return NULL; }
+void mm_pool_free(mm_pool_t *pool, void *ptr) { (void)pool; (void)ptr; }
+int mm_pool_reserve(mm_pool_t *pool, size_t n) { (void)pool; (void)n; return 0; }
+size_t mm_pool_release(mm_pool_t *pool) { (void)pool; return 0; }
+void mm_pool_destroy(mm_pool_t *pool) { (void)pool; }
+
+mm_heap_t *mm_heap_create(void) { return NULL; }
+void mm_heap_destroy(mm_heap_t *heap) { (void)heap; }
+mm_heap_t *mm_heap_use(mm_heap_t *heap) { (void)heap; return NULL; }
+void *mm_heap_malloc(mm_heap_t *heap, size_t size)
+{ (void)heap; return mm_malloc(size); }
+void mm_heap_free(mm_heap_t *heap, void *ptr) { (void)heap; mm_free(ptr); }
+void *mm_heap_realloc(mm_heap_t *heap, void *ptr, size_t size)
+{ (void)heap; return mm_realloc(ptr, size); }
+void *mm_heap_calloc(mm_heap_t *heap, size_t nmemb, size_t size)
+{ (void)heap; return mm_calloc(nmemb, size); }
+
+int mm_mallopt(int param, int value) { (void)param; (void)value; return 0; }
+
+void mm_get_stats(mm_stats_t *out)
+{
+  *out = stats;
+}
+
+
+/**********************************************************************/
+// Bits and records
+
+/*
+ * grains_for - Granules needed for size bytes, or 0 if the heap could
+ *     never hold them
+ */
+static uint32_t grains_for(size_t size)
+{
+  if (size > MAX_HEAP)
+    return 0;
+  return (size + GRAIN - 1) / GRAIN;
+}
+
+/*
+ * class_of - The free list of a block of len granules: floor(log2(len)),
+ *     with everything from 2^(CLASSES-1) granules up in the last list
+ */
+static int class_of(uint32_t len)
+{
+  int c = 31 - __builtin_clz(len);
+
+  return c < CLASSES ? c : CLASSES - 1;
+}
+
+/*
+ * next_start - The first start bit after granule g: the block after the
+ *     one at g, or the end of the heap
+ */
+static uint32_t next_start(uint32_t g)
+{
+  size_t w = (g + 1) >> 6;
+  uint64_t b = map[w].start & (~(uint64_t)0 << ((g + 1) & 63));
+
+  while (b == 0)
+    b = map[++w].start;
+  return (uint32_t)(w * 64 + __builtin_ctzll(b));
+}
+
+/*
+ * start_of - The last start bit at or before granule g: the block that
+ *     holds g
+ */
+static uint32_t start_of(uint32_t g)
+{
+  size_t w = g >> 6;
+  uint64_t b = map[w].start & (~(uint64_t)0 >> (63 - (g & 63)));
+
+  while (b == 0)
+    b = map[--w].start;
+  return (uint32_t)(w * 64 + 63 - __builtin_clzll(b));
+}
+
+/*
+ * grow_tables - Resize the tables to newcap records and at least words
+ *     words of bits. The records come first, then the hash, which keeps
+ *     two slots per record, then the bits, which fill the rest of the
+ *     last page. A new number of records moves the bits up and hashes
+ *     the free blocks again.
+ */
+static int grow_tables(uint32_t newcap, size_t words)
+{
+  size_t front = (size_t)newcap * (sizeof(rec_t) + 2 * sizeof(uint32_t));
+  size_t bytes = front + words * sizeof(word_t);
+  char *p, *oldmap = (char *)map;
+  uint32_t r;
+
+  bytes = (bytes + mem_pagesize() - 1) & ~(mem_pagesize() - 1);
+  p = recs == NULL ? mem_map(bytes) : mem_remap(recs, bytes);
+  if (p == NULL)
+    return -1;
+  if (mapwords > 0 && newcap != cap)
+    memmove(p + front, p + (oldmap - (char *)recs), mapwords * sizeof(word_t));
+  recs = (rec_t *)p;
+  slots = (uint32_t *)(recs + newcap);
+  map = (word_t *)(p + front);
+  mapwords = (bytes - front) / sizeof(word_t);
+  if (newcap != cap) {
+    cap = newcap;
+    hshift = 32 - __builtin_ctz(2 * newcap);
+    memset(slots, 0, 2 * (size_t)newcap * sizeof(uint32_t));
+    for (r = 0; r < used_recs; r++)
+      if (recs[r].len != 0)
+        *slot_of(recs[r].g) = r + 1;
+  }
+  return 0;
+}
+
+/*
+ * map_room - Make the bits reach granule n
+ */
+static int map_room(uint32_t n)
+{
+  if ((size_t)n / 64 < mapwords)
+    return 0;
+  return grow_tables(cap ? cap : INIT_RECS, (size_t)n / 64 + 1);
+}
+
+/*
+ * rec_room - Make room for n more free blocks, doubling the records
+ */
+static int rec_room(uint32_t n)
+{
+  if (live + n <= cap)
+    return 0;
+  return grow_tables(cap ? 2 * cap : INIT_RECS, mapwords);
+}
+
+/*
+ * slot_of - The hash slot that holds the record of the free block at g,
+ *     or the empty slot that ends its probe
+ */
+static uint32_t *slot_of(uint32_t g)
+{
+  uint32_t mask = 2 * cap - 1, i;
+
+  for (i = HASH(g); slots[i] != 0; i = (i + 1) & mask)
+    if (recs[slots[i] - 1].g == g)
+      break;
+  return &slots[i];
+}
+
+/*
+ * insert_free - Give the free block of len granules at g a record and
+ *     push it on its list. rec_room has made room for it.
+ */
+static void insert_free(uint32_t g, uint32_t len)
+{
+  int c = class_of(len);
+  uint32_t r;
+
+  if (spare != 0) {
+    r = spare - 1;
+    spare = recs[r].next;
+  } else {
+    r = used_recs++;
+  }
+  recs[r].g = g;
+  recs[r].len = len;
+  recs[r].next = heads[c];
+  recs[r].prev = 0;
+  if (heads[c] != 0)
+    recs[heads[c] - 1].prev = r + 1;
+  heads[c] = r + 1;
+  *slot_of(g) = r + 1;
+  live++;
+}
+
+/*
+ * remove_free - Take the free block at g off its list and out of the
+ *     hash, shifting back the slots after it, and return its length
+ */
+static uint32_t remove_free(uint32_t g)
+{
+  uint32_t *s = slot_of(g), r = *s - 1, len = recs[r].len;
+  uint32_t mask = 2 * cap - 1, i, j;
+
+  if (recs[r].prev != 0)
+    recs[recs[r].prev - 1].next = recs[r].next;
+  else
+    heads[class_of(len)] = recs[r].next;
+  if (recs[r].next != 0)
+    recs[recs[r].next - 1].prev = recs[r].prev;
+
+  i = s - slots;
+  for (j = (i + 1) & mask; slots[j] != 0; j = (j + 1) & mask)
+    if (((j - HASH(recs[slots[j] - 1].g)) & mask) >= ((j - i) & mask)) {
+      slots[i] = slots[j];
+      i = j;
+    }
+  slots[i] = 0;
+
+  recs[r].len = 0;
+  recs[r].next = spare;
+  spare = r + 1;
+  live--;
+  return len;
+}
+
+/**********************************************************************/
+// Blocks
+
+/*
+ * free_block - Make the len granules at g a free block, merged with
+ *     the free blocks on either side of it. Granule g + len starts a
+ *     block or ends the heap.
+ */
+static void free_block(uint32_t g, uint32_t len)
+{
+  uint32_t p;
+
+  SET_START(g);
+  CLR_USED(g);
+  if (g + len < grains && !USED(g + len)) {
+    CLR_START(g + len);
+    len += remove_free(g + len);
+  }
+  if (g > 0) {
+    p = start_of(g - 1);
+    if (!USED(p)) {
+      CLR_START(g);
+      len += remove_free(p);
+      g = p;
+    }
+  }
+  insert_free(g, len);
+}
+
+/*
+ * place - Allocate asize granules at the start of the free block at g
+ *     and free the rest. The block after it is allocated, since free
+ *     blocks never touch, so the rest needs no coalescing.
+ */
+static void place(uint32_t g, uint32_t asize)
+{
+  uint32_t len = remove_free(g);
+
+  SET_USED(g);
+  if (len > asize) {
+    SET_START(g + asize);
+    insert_free(g + asize, len - asize);
+  }
+}
+
+/*
+ * find_fit - First fit in the class of asize. Any block of a larger
+ *     class fits, except in the last class, which holds every length
+ *     from its lower bound up.
+ */
+static long find_fit(uint32_t asize)
+{
+  uint32_t r;
+  int c;
+
+  for (c = class_of(asize); c < CLASSES; c++)
+    for (r = heads[c]; r != 0; r = recs[r - 1].next)
+      if (recs[r - 1].len >= asize)
+        return recs[r - 1].g;
+  return -1;
+}
+
+/*
+ * extend_heap - Get asize granules at the end of the heap as a free
+ *     block, counting a free block already there towards them
+ */
+static long extend_heap(uint32_t asize)
+{
+  uint32_t last = 0, more, g;
+
+  if (grains > 0) {
+    g = start_of(grains - 1);
+    if (!USED(g))
+      last = grains - g;
+  }
+  more = asize - last;
+  if (map_room(grains + more) < 0 ||
+      mem_sbrk((size_t)more * GRAIN) == (void *)-1)
+    return -1;
+  g = grains;
+  grains += more;
+  SET_START(grains);
+  free_block(g, more);
+  return grains - asize;
+}
+
+/**********************************************************************/
+// Printing and checking helpers for debugging
+
+/*
+ * checkheap - Walk the heap block by block, checking that used bits sit
+ *     only on block starts, that each free block has a record of its
+ *     length and that no two free blocks touch, then walk the lists,
+ *     checking their links and that they hold every free block once
+ */
+void mm_checkheap(int verbose)
+{
+  uint32_t g, len, r, *s, nfree = 0, nlisted = 0;
+  size_t w;
+  int c;
+
+  if ((char *)mem_heap_hi() + 1 != PAYLOAD(grains))
+    printf("Error: heap ends at %p, not %p\n",
+           (char *)mem_heap_hi() + 1, PAYLOAD(grains));
+  if (map == NULL)
+    return;
+  if (!START(grains))
+    printf("Error: no start bit at the end of the heap\n");
+  for (w = 0; w < mapwords; w++)
+    if (map[w].used & ~map[w].start)
+      printf("Error: used bits off block starts in granules %zu-%zu\n",
+             w * 64, w * 64 + 63);
+
+  for (g = 0; g < grains; g += len) {
+    len = next_start(g) - g;
+    if (!USED(g)) {
+      nfree++;
+      if (*(s = slot_of(g)) == 0 || recs[*s - 1].len != len)
+        printf("Error: free block %p has no record of its length\n",
+               PAYLOAD(g));
+      if (g + len < grains && !USED(g + len))
+        printf("Error: free blocks %p and %p are not coalesced\n",
+               PAYLOAD(g), PAYLOAD(g + len));
+    }
+    if (verbose)
+      printf("%p: %s, %u granules\n", PAYLOAD(g), USED(g) ? "allocated" : "free",
+             len);
+  }
+
+  for (c = 0; c < CLASSES; c++)
+    for (r = heads[c]; r != 0; r = recs[r - 1].next) {
+      nlisted++;
+      g = recs[r - 1].g;
+      if (!START(g) || USED(g))
+        printf("Error: record %u is for %p, which starts no free block\n",
+               r - 1, PAYLOAD(g));
+      if (class_of(recs[r - 1].len) != c)
+        printf("Error: block %p is on list %d, not %d\n", PAYLOAD(g), c,
+               class_of(recs[r - 1].len));
+      if (recs[r - 1].next != 0 && recs[recs[r - 1].next - 1].prev != r)
+        printf("Error: links of %p and the block after it differ\n",
+               PAYLOAD(g));
+      if (nlisted > nfree)
+        break;
+    }
+  if (nlisted != nfree || live != nfree)
+    printf("Error: %u free blocks, %u on the lists, %u records\n", nfree,
+           nlisted, live);
+}
@@ -4,13 +4,19 @@
  * This is the only file you should modify.
  */
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#ifdef THREAD_SAFE
+#include <pthread.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
+#include "config.h"
 
 /* If you want debugging output, use the following macro.  When you hand
  * in, remove the #define DEBUG line. */
@@ -28,78 +34,576 @@
 # define dbg_vb_printf(...)
 #endif
 
-/* single word (4) or double word (8) alignment */
+/* double word (8) alignment, or 16 bytes with -DALIGN16 for SIMD data.
+   Every block size is a multiple of it. */
+#ifdef ALIGN16
+#define ALIGNMENT 16
+#else
 #define ALIGNMENT 8
+#endif
 
 /* rounds up to the nearest multiple of ALIGNMENT */
-#define ALIGN(p) (((size_t)(p) + (ALIGNMENT-1)) & ~0x7)
+#define ALIGN(p) (((size_t)(p) + (ALIGNMENT-1)) & ~(size_t)(ALIGNMENT-1))
+
 
+/*
+ * Boundary tags are 32-bit words, which keeps an allocated block's
+ * overhead at 4 bytes but caps every block below 4 GB. -DWIDE makes them
+ * 64 bits: each block pays 4 more bytes of header and the smallest free
+ * block grows to 32, in exchange for blocks as large as the heap.
+ */
+#ifdef WIDE
+#define TSIZE       8       /* tag size (bytes) */
+typedef unsigned long tag_t;
+#else
+#define TSIZE       4
+typedef unsigned int tag_t;
+#endif
 
 /* $begin mallocmacros */
 /* Basic constants and macros */
 #define WSIZE       4       /* word size (bytes) */  
 #define DSIZE       8       /* doubleword size (bytes) */
 #define CHUNKSIZE  (1<<9)  /* initial heap size (bytes) */
-#define OVERHEAD    8       /* overhead of header and footer (bytes) */
-#define MINPAYLOAD  16    /* payload (prev and next of type void*) (bytes) */
+#define OVERHEAD    TSIZE   /* overhead of an allocated block: header only */
+#define MINPAYLOAD  (2*LINKSIZE) /* payload of a free block: prev and next links */
 #define ARRAYSIZE (0x58)  /* array of class size at start of heap */
+#define PROLOGUE  MAX(2*TSIZE, ALIGNMENT) /* prologue block size */
+#define PADSIZE   ((ALIGNMENT - (ARRAYSIZE + TSIZE) % ALIGNMENT) % ALIGNMENT)
+                          /* so that the prologue payload is aligned */
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))  
+#define MIN(x, y) ((x) < (y)? (x) : (y))
+#define MINBLOCK    ALIGN(TSIZE + MINPAYLOAD + TSIZE) /* a free block: tags + links */
+#define PLACE_BACK  256     /* blocks this big are split off the end of a fit */
+
+/* Largest request a tag can describe, with room left for ADJUST */
+#define MAX_REQUEST ((size_t)(tag_t)~0x7 - 2*DSIZE)
+
+/* Block size needed for a payload of size bytes */
+#define ADJUST(size) MAX(MINBLOCK, ALIGN((size) + (OVERHEAD)))
+
+/*
+ * Only free blocks have a footer. Bit 1 of every header says whether the
+ * block just before it is allocated, which is all coalesce() needs to
+ * know; PREV_BLKP (which reads that footer) is only valid when it is clear.
+ */
+#define PREV_ALLOC  0x2
+
+/*
+ * Bit 2 of a free block's header (ZERO) says every byte of it other than
+ * the tags and the list links is known to be zero, as heap memory that
+ * mem_clean_lo says was never handed out is; mm_calloc then only has to
+ * clear those few words. Free blocks lose the bit as soon as they are
+ * merged with one that is not known zero. (In an allocated header the
+ * same bit is GROWN, below.)
+ */
+#define ZERO        0x4
+#define GET_ZERO(p) (GET(p) & ZERO)
 
-/* Pack a size and allocated bit into a word */
+/* Pack a size and allocated bit(s) into a word */
 #define PACK(size, alloc)  ((size) | (alloc))
 
-/* Read and write a word at address p */
-/* NB: this code calls a 32-bit quantity a word */
-#define GET(p)       (*(unsigned int *)(p))
-#define PUT(p, val)  (*(unsigned int *)(p) = (val))
+/* Read and write a tag at address p */
+#define GET(p)       (*(tag_t *)(p))
+#define PUT(p, val)  (*(tag_t *)(p) = (val))
 #define PUT_ADDR(p, val)  (*(unsigned long *)(p) = (unsigned long)(val))
 #define GET_ADDR(p)  (*(unsigned long*)(p))
 
+/*
+ * The prev and next links of a free block are full pointers, unless
+ * -DCOMPACT_LINKS makes them 32-bit offsets from the start of the heap
+ * (0 for none). That halves MINPAYLOAD, so the smallest block drops from
+ * 24 bytes to 16. The list heads stay full pointers either way. PUT_LINK
+ * may evaluate bp twice, so it must not be a call.
+ */
+#ifdef COMPACT_LINKS
+#ifdef WIDE
+#error "COMPACT_LINKS needs a heap below 4 GB, which WIDE does not have"
+#endif
+#define LINKSIZE    4
+typedef unsigned int link_t;
+#define PUT_LINK(p, bp)  (*(link_t *)(p) = \
+                          (bp) ? (link_t)((char *)(bp) - heap->saveroot) : 0)
+#define GET_LINK(p)  (*(link_t *)(p) ? \
+                      (char *)heap->saveroot + *(link_t *)(p) : NULL)
+#else
+#define LINKSIZE    DSIZE
+#define PUT_LINK(p, bp)  PUT_ADDR(p, bp)
+#define GET_LINK(p)  ((char *)GET_ADDR(p))
+#endif
+
 /* Read the size and allocated fields from address p */
 #define GET_SIZE(p)  (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
+#define GET_PREV_ALLOC(p) (GET(p) & PREV_ALLOC)
+#define SET_PREV_ALLOC(p) PUT(p, GET(p) | PREV_ALLOC)
+#define CLR_PREV_ALLOC(p) PUT(p, GET(p) & ~PREV_ALLOC)
 
-/* Given block ptr bp, compute address of its header and footer */
-#define HDRP(bp)       ((char *)(bp) - WSIZE)  
-#define FTRP(bp)       ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
+/* Given block ptr bp, compute address of its header and (free) footer */
+#define HDRP(bp)       ((char *)(bp) - TSIZE)  
+#define FTRP(bp)       ((char *)(bp) + GET_SIZE(HDRP(bp)) - 2*TSIZE)
 
 /* Given block ptr bp, compute address of next and previous blocks */
-#define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
-#define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
+#define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(((char *)(bp) - TSIZE)))
+#define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - 2*TSIZE)))
 
 /* Given block ptr bp, compute pointers to next and previous free blocks */
-#define NEXT_PTR(bp)  ((char *)(bp) + DSIZE)
+#define NEXT_PTR(bp)  ((char *)(bp) + LINKSIZE)
 #define PREV_PTR(bp)  ((char *)(bp))
 
 /* Given block ptr bp, compute address of next and previous free blocks */
-#define NEXT_FREE(bp)  ((char *)(GET_ADDR(NEXT_PTR(bp))))
-#define PREV_FREE(bp)  ((char *)(GET_ADDR(PREV_PTR(bp))))
+#define NEXT_FREE(bp)  GET_LINK(NEXT_PTR(bp))
+#define PREV_FREE(bp)  GET_LINK(PREV_PTR(bp))
 
 /* Give the payload size of the block */
-#define PAYLOAD_SIZE(bp) ((size_t)(GET_SIZE(((char *)(bp) - WSIZE)) - DSIZE))
+#define PAYLOAD_SIZE(bp) ((size_t)(GET_SIZE(((char *)(bp) - TSIZE)) - OVERHEAD))
 
 /* Get the list of free block from the array of size classes */
 #define ROOT_LIST(root) ((char *)(GET_ADDR(root)))
 
 /* $end mallocmacros */
 
-/* Global variables */
-static char *heap_listp = 0x0;  /* pointer to first block */  
-static const char *saveroot;  /* saved address of first array entry */
 /* Get the address of the nth array entry */
-#define ARRAY(n) ((char *)(saveroot + (n << 0x3)))
+#define ARRAY(n) ((char *)(heap->saveroot + (n << 0x3)))
+
+#ifdef TLSF
+/*
+ * Two-level segregated fit (-DTLSF). Free blocks are filed by size under
+ * a first level (power of two) and a second level (SL_COUNT linear steps
+ * within that power); blocks below TLSF_SMALL get exact 8-byte classes
+ * in first level 0. A bitmap per level records which lists are non-empty,
+ * so mapping a size and finding a list that is guaranteed to fit are both
+ * a handful of bit operations, whatever the number of free blocks. The
+ * list heads live here instead of in the array at saveroot.
+ */
+#define SL_BITS     4
+#define SL_COUNT    (1 << SL_BITS)
+#define TLSF_SHIFT  (SL_BITS + 3)            /* log2(TLSF_SMALL) */
+#define TLSF_SMALL  (1 << TLSF_SHIFT)
+#define FL_COUNT    (8*TSIZE - TLSF_SHIFT + 1)
+
+
+static void tlsf_mapping(size_t size, int *fl, int *sl);
+static void checkindex(void);
+#define LINKBYTES(bp) MINPAYLOAD
+#else
+/*
+ * Size tree. Free blocks of TREE_MIN bytes and up all share the last
+ * size class, so rather than on a list they are kept in an AA tree (a
+ * red-black tree that needs only a level per node) keyed by size, and
+ * find_fit gets the best fit among them in O(log n) however many there
+ * are. A node is the first of a chain of the free blocks of its size,
+ * linked through the usual prev and next links; its left, right and
+ * level words follow those, and remove_free clears them again so that a
+ * ZERO block stays zero. The root lives in the last array entry. The
+ * tree is off by default, since on the default traces, with few large
+ * free blocks, its upkeep costs more than the list walks it saves; M_TREE,
+ * read by mm_init, turns it on.
+ */
+#define TREE_MIN    (1<<14)
+#define TREE_ROOT   ((char *)heap->saveroot+0x50)
+#define TREE_BYTES  (3*LINKSIZE)
+#define LEFT_PTR(bp)   ((char *)(bp) + MINPAYLOAD)
+#define RIGHT_PTR(bp)  ((char *)(bp) + MINPAYLOAD + LINKSIZE)
+#define LEVEL_PTR(bp)  ((unsigned int *)((char *)(bp) + MINPAYLOAD + 2*LINKSIZE))
+#define LEFT(bp)   GET_LINK(LEFT_PTR(bp))
+#define RIGHT(bp)  GET_LINK(RIGHT_PTR(bp))
+#define LEVEL(bp)  ((bp) ? *LEVEL_PTR(bp) : 0)  /* 0 for none */
+static int tree_enabled = 0;               /* M_TREE */
+
+/*
+ * Address index (M_ADDR_FIT, off by default). Free blocks of ADDR_MIN
+ * bytes and up can instead all go in one AA tree keyed by address, whose
+ * root lives in the array entry for ADDR_MIN. Each node also holds the
+ * largest size in its subtree, so find_fit can take the lowest-addressed
+ * block that fits, first fit over the whole heap as mm-implicit.c does
+ * it, in O(log n) steps: it goes left whenever the left subtree has a
+ * block big enough. A node's prev and next links are its left and right
+ * children; the max and level words follow them. Smaller blocks stay on
+ * their lists, which those requests search first.
+ */
+#define ADDR_MIN    (1<<6)
+#define ADDR_ROOT   ((char *)heap->saveroot+0x10)
+#define ADDR_BYTES  (TSIZE + 4)
+#define ALEFT(bp)   PREV_FREE(bp)
+#define ARIGHT(bp)  NEXT_FREE(bp)
+#define AMAX_PTR(bp)   ((char *)(bp) + MINPAYLOAD)
+#define ALEVEL_PTR(bp) ((unsigned int *)((char *)(bp) + MINPAYLOAD + TSIZE))
+#define AMAX(bp)    ((bp) ? (size_t)GET(AMAX_PTR(bp)) : 0)   /* 0 for none */
+#define ALEVEL(bp)  ((bp) ? *ALEVEL_PTR(bp) : 0)
+static int addr_enabled = 0;               /* M_ADDR_FIT */
+
+/* Bytes at the start of free block bp that are not payload */
+#define LINKBYTES(bp)  (heap->addr && GET_SIZE(HDRP(bp)) >= ADDR_MIN ? \
+                        MINPAYLOAD + ADDR_BYTES : \
+                        heap->tree && GET_SIZE(HDRP(bp)) >= TREE_MIN ? \
+                        MINPAYLOAD + TREE_BYTES : MINPAYLOAD)
+
+static char *tree_skew(char *t);
+static char *tree_split(char *t);
+static char *tree_insert(char *t, char *bp, size_t size);
+static char *tree_delete(char *t, size_t size);
+static void tree_remove(char *bp, size_t size);
+static char *tree_fit(size_t asize);
+static void tree_purge(char *t);
+static void checktree(char *t, size_t lo, size_t hi);
+static void addr_fix(char *t);
+static char *addr_skew(char *t);
+static char *addr_split(char *t);
+static char *addr_insert(char *t, char *bp);
+static char *addr_delete(char *t, char *bp);
+static char *addr_fit(size_t asize);
+static void addr_purge(char *t);
+static void checkaddr(char *t, char *lo, char *hi);
+#endif
+
+/*
+ * Slab pages. Requests of up to SLAB_MAXSIZE bytes are served from
+ * SLAB_PAGE-sized, SLAB_PAGE-aligned runs that hold objects of a single
+ * size class and carry no per-object header or footer. Each run starts
+ * with a slab_t descriptor whose bitmap records which objects are in use;
+ * an object finds its descriptor by rounding its address down to the
+ * page. The run itself is an ordinary allocated block of the heap, and
+ * slab_pages (one bit per heap page) tells mm_free whether a pointer
+ * lives in one.
+ */
+#define SLAB_PAGE     4096
+#define SLAB_SHIFT    12
+#define SLAB_MAXSIZE  64
+#ifdef ALIGN16
+#define SLAB_CLASSES  4
+#else
+#define SLAB_CLASSES  6
+#endif
+#define SLAB_WORDS    ((SLAB_PAGE/DSIZE + 63) / 64) /* bitmap words */
+
+typedef struct slab {
+  struct slab *next;       /* next run of this class with free objects */
+  struct slab *prev;
+  unsigned short osize;    /* object size (bytes) */
+  unsigned short cls;      /* size class */
+  unsigned short nobj;     /* objects in this run */
+  unsigned short nfree;    /* objects not in use */
+  unsigned long map[SLAB_WORDS]; /* bit set = object in use */
+} slab_t;
+
+#define SLAB_HDR      ALIGN(sizeof(slab_t))  /* offset of the first object */
+#define SLAB_OF(p)    ((slab_t *)((size_t)(p) & ~(size_t)(SLAB_PAGE-1)))
+#define SLAB_INDEX(p) (((size_t)(p) - \
+                        ((size_t)heap->saveroot & ~(size_t)(SLAB_PAGE-1))) >> SLAB_SHIFT)
+
+#ifdef ALIGN16
+static const unsigned short slab_size[SLAB_CLASSES] = { 16, 32, 48, 64 };
+/* size class for requests of (size+7)/8 doublewords, rounded up to 16 */
+static const unsigned char slab_class[SLAB_MAXSIZE/DSIZE + 1] =
+  { 0, 0, 0, 1, 1, 2, 2, 3, 3 };
+#else
+static const unsigned short slab_size[SLAB_CLASSES] = { 8, 16, 24, 32, 48, 64 };
+/* size class for requests of (size+7)/8 doublewords */
+static const unsigned char slab_class[SLAB_MAXSIZE/DSIZE + 1] =
+  { 0, 0, 1, 2, 3, 4, 4, 5, 5 };
+#endif
+
+/*
+ * A class only switches to slab runs after slab_threshold requests for
+ * it, so a program with a handful of small objects does not pay a whole
+ * page per class.
+ */
+static int slab_enabled = 1;              /* M_SLAB */
+static int slab_threshold = 256;          /* M_SLAB_THRESHOLD */
+
+/*
+ * Realloc growth reservations. Bit 2 of an allocated block's header
+ * (GROWN) says realloc has grown it before; growing it again is taken as
+ * a steady growth pattern, and the block is sized for RESV_SIZE of the
+ * request so that the next few reallocs finish in place. Each block with
+ * such headroom is listed in resv[] with the size it actually needs, and
+ * malloc_block() trims them all back before it extends the heap.
+ *
+ * resv[] is a fixed table of RESV_SLOTS entries, scanned linearly by
+ * resv_drop(); a handful of blocks growing at once is the case it is
+ * for. It is only emptied when resv_reclaim() runs, so once it is full
+ * any further block that grows gets no headroom: it is shrunk back to
+ * the size asked for, and reallocs of it move or extend in place as
+ * they would with M_REALLOC_RESERVE off. Blocks already listed keep
+ * their slot, since re-listing them follows a resv_drop().
+ */
+#define GROWN       0x4
+#define GET_GROWN(p) (GET(p) & GROWN)
+#define SET_GROWN(p) PUT(p, GET(p) | GROWN)
+#define CLR_GROWN(p) PUT(p, GET(p) & ~GROWN)
+#define RESV_SLOTS  16
+#define RESV_SIZE(asize) ALIGN((asize) + (asize)/2)
+
+typedef struct {
+  char *bp;               /* block holding headroom */
+  size_t asize;           /* block size it needs without the headroom */
+} resv_t;
+
+static int resv_enabled = 1;               /* M_REALLOC_RESERVE */
+static int known_zero = 1;                 /* M_KNOWN_ZERO */
+
+/*
+ * Giving memory back. A free block at the top of the heap bigger than
+ * trim_threshold is returned to memlib, all but TRIM_PAD bytes of it, and
+ * free blocks of at least PURGE_MIN bytes inside the heap give their
+ * whole interior pages back with mem_purge. The header, links and footer
+ * stay on the partial pages at either end, which are cleared instead, so
+ * a purged block is all zero and gets the ZERO bit; ZERO blocks are never
+ * purged again.
+ *
+ * free() trims the top as soon as it leaves it over the threshold, but
+ * purging is kept off its fast path. free() only counts the bytes that
+ * large free blocks add; once purge_pending reaches purge_batch and
+ * purge_delay ms have passed since the last pass, purge_free() walks the
+ * large-block lists in one go. Pages handed back cost a page fault each
+ * when reused, so memory freed during a burst is left in place until the
+ * burst is over.
+ */
+#define TRIM_PAD    CHUNKSIZE
+#define PURGE_MIN   (4*SLAB_PAGE)
+static size_t trim_threshold = 128*1024;   /* M_TRIM_THRESHOLD */
+static size_t purge_batch = 256*1024;      /* M_PURGE_BATCH */
+static long purge_delay = 10;              /* M_PURGE_DELAY, in ms */
+
+/*
+ * Requests of at least mmap_threshold bytes skip the heap and get a
+ * region of their own from mem_map; free() unmaps it right away and
+ * realloc() resizes it with mem_remap. The MAP_HDR bytes before the
+ * payload hold the number of bytes from there to the end of the region,
+ * then a header whose size field is 0, which no heap block has. For an
+ * aligned block they need not be at the start of the region.
+ */
+#define MAP_HDR     (2*DSIZE)
+#define IS_MAPPED(bp) (GET_SIZE(HDRP(bp)) == 0)
+#define MAP_BASE(bp)  ((char *)(bp) - MAP_HDR)
+#define MAP_LEN(bp)   (*(size_t *)MAP_BASE(bp))
+#define MAP_END(p)    (((size_t)(p) + mem_pagesize()-1) & ~(mem_pagesize()-1))
+#define WANT_MAP(size) (mmap_threshold && (size) >= mmap_threshold)
+static size_t mmap_threshold = 128*1024;   /* M_MMAP_THRESHOLD, 0 is off */
+
+/*
+ * Fast bins. A freed heap block of at most fast_maxsize bytes is not
+ * coalesced: it stays marked allocated and goes on the LIFO of its exact
+ * size, linked through its first payload word, so the next malloc of
+ * that size takes it straight back without a split. The bins are emptied
+ * into the free lists (consolidated) when a request finds no fit, when
+ * mm_trim runs, and whenever they hold more than fast_consolidate bytes,
+ * which bounds the fragmentation they can cause.
+ */
+#define FAST_LIMIT  1024                   /* largest M_FAST_MAXSIZE */
+#define FAST_BINS   (FAST_LIMIT/ALIGNMENT + 1)
+#define FAST_BIN(size) ((size) / ALIGNMENT)
+static int fast_enabled = 1;               /* M_FAST */
+static size_t fast_maxsize = 48;           /* M_FAST_MAXSIZE, block bytes */
+static size_t fast_consolidate = 64*1024;  /* M_FAST_CONSOLIDATE */
+
+/*
+ * Region arenas. An arena takes chunks of arena->chunk bytes from
+ * mm_malloc and hands out their memory by bumping arena->brk, with no
+ * header per object; nothing is freed on its own. mm_arena_reset moves
+ * brk back to the start of the first chunk and keeps the chunks for
+ * reuse, so it takes constant time apart from the objects too big for a
+ * chunk, which get one of their own on arena->big and are freed then.
+ * The arena itself lives at the start of its first chunk.
+ */
+#define ARENA_CHUNK  (64*1024)  /* default chunk size */
+#define ARENA_MIN    1024       /* smallest chunk size */
+#define ARENA_HDR    ALIGN(sizeof(arena_chunk_t)) /* offset of the first object */
+#define ARENA_START  (ARENA_HDR + ALIGN(sizeof(mm_arena_t))) /* ... in the first chunk */
+
+typedef struct arena_chunk {
+  struct arena_chunk *next; /* next chunk, kept across resets */
+  char *end;                /* one past its last byte */
+} arena_chunk_t;
+
+struct mm_arena {
+  arena_chunk_t *first;     /* chunk holding the arena */
+  arena_chunk_t *cur;       /* chunk being bumped through */
+  arena_chunk_t *big;       /* big objects, one chunk each */
+  char *brk;                /* next free byte in cur */
+  size_t chunk;             /* size of a chunk */
+};
+
+/*
+ * Fixed-size object pools. A pool carves chunks from mm_malloc into
+ * objects of one size, with no header per object. Free objects of all
+ * chunks are on one LIFO list linked through their first word, so the
+ * object freed last, still warm in the cache, is the next one handed
+ * out; alloc and free touch nothing else. Only mm_pool_release needs to
+ * know which chunk an object is in, and finds it by binary search in
+ * the chunks sorted by address.
+ */
+#define POOL_CHUNK   (16*1024)  /* smallest chunk size */
+#define POOL_MINOBJ  8          /* a chunk holds at least this many objects */
+
+typedef struct pool_chunk {
+  struct pool_chunk *next;  /* next chunk of the pool */
+  size_t nfree;             /* free objects, counted by mm_pool_release */
+} pool_chunk_t;
+
+struct mm_pool {
+  pool_chunk_t *chunks;     /* every chunk of the pool */
+  size_t nchunks;
+  char *free;               /* LIFO of free objects */
+  size_t nfree;             /* objects on it */
+  size_t osize;             /* object size, a multiple of the alignment */
+  size_t first;             /* offset of a chunk's first object */
+  size_t nobj;              /* objects per chunk */
+  size_t chunk;             /* chunk size */
+  size_t align;             /* alignment of the objects and chunks */
+};
+
+#ifdef THREAD_SAFE
+/*
+ * Thread-safe build. A heap (its blocks, list heads and the rest of its
+ * mm_heap_t) is shared and guarded by its own lock. In front of the
+ * default heap every thread keeps a tcache: one small LIFO per exact
+ * block size up to TC_MAXSIZE, singly linked through the first payload
+ * word. Cached blocks stay marked allocated in the heap, so coalesce()
+ * never sees them, and the common malloc/free of a small size never
+ * takes the lock. Heaps from mm_heap_create are not cached.
+ */
+#define TC_MAXSIZE  256               /* largest block size kept in a tcache */
+#define TC_BINS     (TC_MAXSIZE/ALIGNMENT + 1)
+#define TC_NBINS    (TC_BINS + SLAB_CLASSES) /* block bins, then slab bins */
+#define TC_COUNT    16                /* max blocks per tcache bin */
+#define TC_REFILL   (TC_COUNT/4)      /* most blocks carved per locked refill */
+#define TC_BIN(asize) ((asize) / ALIGNMENT)
+#define TC_SLAB_BIN(cls) (TC_BINS + (cls))
+
+typedef struct {
+  unsigned long gen;      /* heap generation the cached blocks belong to */
+  int registered;         /* thread-exit destructor installed? */
+  int count[TC_NBINS];    /* number of blocks in each bin */
+  int fill[TC_NBINS];     /* blocks the next refill of each bin carves */
+  char *bin[TC_NBINS];    /* first cached block of each size */
+} tcache_t;
+
+static pthread_key_t tc_key;
+static pthread_once_t tc_key_once = PTHREAD_ONCE_INIT;
+static pthread_once_t heap0_once = PTHREAD_ONCE_INIT; /* lazy mm_init of heap0 */
+static volatile unsigned long heap_gen = 0; /* bumped by every mm_init */
+static __thread tcache_t tcache;
+
+/* mm_malloc counts slab demand before it takes the lock */
+# define DEMAND_INC(n, k) __atomic_fetch_add(&(n), (k), __ATOMIC_RELAXED)
+# define LOCK()   pthread_mutex_lock(&heap->lock)
+# define UNLOCK() pthread_mutex_unlock(&heap->lock)
+# define TC_HEAP() (heap == &heap0)  /* may the tcache be used? */
+# define HEAP_TLS __thread
+#else
+# define DEMAND_INC(n, k) (((n) += (k)) - (k))
+# define LOCK()
+# define UNLOCK()
+# define HEAP_TLS
+#endif
+
+/*
+ * Heaps. Everything mm.c knows about a heap lives in its mm_heap_t, next
+ * to the memlib instance it grows; the tuning knobs above are shared by
+ * all heaps. heap is the one the calling thread works on: heap0, the
+ * default heap behind mm_malloc and the rest of the API, unless an
+ * mm_heap_xxx call or mm_heap_use has switched it. A heap made by
+ * mm_heap_create keeps its mm_heap_t in a region of its own memlib
+ * instance, so mm_heap_destroy drops it along with everything else.
+ */
+struct mm_heap {
+  char *listp;                 /* pointer to first block */
+  const char *saveroot;        /* saved address of first array entry */
+  mem_heap_t *mem;             /* memlib instance it grows in (NULL: default) */
+#ifdef THREAD_SAFE
+  pthread_mutex_t lock;
+#endif
+#ifdef TLSF
+  unsigned long fl_bitmap;
+  unsigned int sl_bitmap[FL_COUNT];
+  unsigned long tlsf_head[FL_COUNT][SL_COUNT]; /* same words as ARRAY() */
+#else
+  int tree;                    /* large free blocks in the size tree (M_TREE) */
+  int addr;                    /* free blocks in the address index (M_ADDR_FIT) */
+#endif
+  int slab_demand[SLAB_CLASSES];      /* requests seen per class */
+  slab_t *slab_partial[SLAB_CLASSES]; /* runs with free objects */
+  unsigned char slab_pages[MAX_HEAP/SLAB_PAGE/8 + 1];
+  size_t purge_pending;               /* candidate bytes since the last pass */
+  struct timespec purge_last;         /* time of the last pass */
+  resv_t resv[RESV_SLOTS];
+  int resv_count;
+  char *fast[FAST_BINS];              /* fast bins, by block size */
+  size_t fast_bytes;                  /* bytes in them */
+  mm_stats_t stats;                   /* counters since mm_init */
+};
+
+#ifdef THREAD_SAFE
+static mm_heap_t heap0 = { .lock = PTHREAD_MUTEX_INITIALIZER };
+#else
+static mm_heap_t heap0;
+#endif
+static HEAP_TLS mm_heap_t *heap = &heap0;
 
 /* function prototypes for internal helper routines */
 static void *extend_heap(size_t words);
-static void place(void *bp, size_t asize);
+static void *place(void *bp, size_t asize);
 static void *find_fit(size_t asize);
 static void *coalesce(void *bp);
+#ifndef TLSF
 static void *indirection(size_t size);
+#endif
+static void insert_free(void *bp);
+static void remove_free(void *bp);
+static void *malloc_block(size_t asize);
+static void *fit_block(size_t asize);
+static void *fit_run(size_t asize, size_t count);
+static size_t carve_blocks(void *bp, size_t asize, size_t count, void **out);
+static int addr_cmp(const void *a, const void *b);
+static int pool_grow(mm_pool_t *pool);
+static pool_chunk_t *pool_chunk_of(mm_pool_t *pool, pool_chunk_t **cs,
+                                   size_t n, const char *p);
+static void *calloc_block(size_t asize, size_t bytes);
+static void *malloc_aligned_block(size_t asize, size_t align);
+static void free_block(void *bp);
+static void free_payload(void *bp, int slab);
+static void release_block(void *bp);
+static void fast_free(void *bp);
+static void consolidate(void);
+static void *map_block(size_t size, size_t align);
+static void *remap_block(void *bp, size_t size);
+static size_t block_payload(void *bp);
+static int trim_top(size_t pad);
+static int purge_due(void);
+static void purge_free(void);
+static void purge_block(void *bp);
+static void *realloc_block(void *bp, size_t asize);
+static void shrink_block(void *bp, size_t asize);
+static int resv_add(void *bp, size_t asize);
+static size_t resv_drop(void *bp);
+static void lazy_init(void);
+static void resv_reclaim(void);
+static void count_realloc(int moved, size_t bytes);
+static int is_slab(const void *p);
+static void *slab_alloc(int cls);
+static void slab_free(void *p);
+static slab_t *slab_new(int cls);
+static void slab_link(slab_t *s);
+static void slab_unlink(slab_t *s);
+#ifdef THREAD_SAFE
+static tcache_t *tc_get(void);
+static void *tc_pop(int b);
+static void *tc_alloc(int b, size_t asize);
+static void tc_free(int b, void *bp);
+static void tc_flush(tcache_t *tc, int b, int keep);
+static void tc_destroy(void *arg);
+static void tc_key_init(void);
+#endif
 //
 static void printblock(void *bp); 
 static void checkblock(void *bp);
 static void printlist(void *root);
+static void checkslabs(void);
+static void checkresv(void);
+static void checkfast(void);
 static int in_heap(const void *p);
 static int aligned(const void *p);
 /* helpers for doubly linked list operations */
@@ -119,29 +623,52 @@ static void dbll_remove(void *list_ptr, void *bp);
 /* $begin mminit */
 int mm_init(void) 
 {
+#ifdef THREAD_SAFE
+  /* blocks still sitting in any thread's tcache belong to the old heap */
+  if (TC_HEAP())
+    heap_gen++;
+#endif
   /* create the initial empty heap */
-  if ((heap_listp = mem_sbrk(ARRAYSIZE+4*WSIZE)) == NULL)
+  if ((heap->listp = mem_sbrk(ARRAYSIZE+PADSIZE+TSIZE+PROLOGUE)) == NULL)
     return -1;
-  saveroot = heap_listp;
+  heap->saveroot = heap->listp;
 
-  PUT(heap_listp+ARRAYSIZE, 0); // alignment padding, 4 bytes, 9-12
-  PUT(heap_listp+ARRAYSIZE+WSIZE, PACK(OVERHEAD, 1)); // prologue header, 4 bytes, 13-16
-  PUT(heap_listp+ARRAYSIZE+DSIZE, PACK(OVERHEAD, 1)); // prologue footer, 4 bytes, 17-20
-  PUT(heap_listp+ARRAYSIZE+WSIZE+DSIZE, PACK(0, 1)); // epilogue header, 4 bytes, 21-24
-  heap_listp += ARRAYSIZE+DSIZE;
+  memset(heap->listp+ARRAYSIZE, 0, PADSIZE); // alignment padding, 9-12
+  heap->listp += ARRAYSIZE+PADSIZE+TSIZE;
+  PUT(HDRP(heap->listp), PACK(PROLOGUE, PREV_ALLOC | 1)); // prologue header, 13-16
+  PUT(FTRP(heap->listp), PACK(PROLOGUE, 1)); // prologue footer, 17-20
+  PUT(HDRP(NEXT_BLKP(heap->listp)), PACK(0, PREV_ALLOC | 1)); // epilogue header, 21-24
 
   // initializing the array
-  PUT_ADDR(saveroot, 0x0); // saveroot at the very start of heap, 8 bytes, 0-8
-  PUT_ADDR(saveroot+0x8, 0x0);
-  PUT_ADDR(saveroot+0x10, 0x0);
-  PUT_ADDR(saveroot+0x18, 0x0);
-  PUT_ADDR(saveroot+0x20, 0x0);
-  PUT_ADDR(saveroot+0x28, 0x0);
-  PUT_ADDR(saveroot+0x30, 0x0);
-  PUT_ADDR(saveroot+0x38, 0x0);
-  PUT_ADDR(saveroot+0x40, 0x0);
-  PUT_ADDR(saveroot+0x48, 0x0);
-  PUT_ADDR(saveroot+0x50, 0x0);
+  PUT_ADDR(heap->saveroot, 0x0); // saveroot at the very start of heap, 8 bytes, 0-8
+  PUT_ADDR(heap->saveroot+0x8, 0x0);
+  PUT_ADDR(heap->saveroot+0x10, 0x0);
+  PUT_ADDR(heap->saveroot+0x18, 0x0);
+  PUT_ADDR(heap->saveroot+0x20, 0x0);
+  PUT_ADDR(heap->saveroot+0x28, 0x0);
+  PUT_ADDR(heap->saveroot+0x30, 0x0);
+  PUT_ADDR(heap->saveroot+0x38, 0x0);
+  PUT_ADDR(heap->saveroot+0x40, 0x0);
+  PUT_ADDR(heap->saveroot+0x48, 0x0);
+  PUT_ADDR(heap->saveroot+0x50, 0x0);
+#ifdef TLSF
+  heap->fl_bitmap = 0;
+  memset(heap->sl_bitmap, 0, sizeof(heap->sl_bitmap));
+  memset(heap->tlsf_head, 0, sizeof(heap->tlsf_head));
+#else
+  heap->tree = tree_enabled;
+  heap->addr = addr_enabled;
+#endif
+
+  memset(heap->slab_demand, 0, sizeof(heap->slab_demand));
+  memset(heap->slab_partial, 0, sizeof(heap->slab_partial));
+  memset(heap->slab_pages, 0, sizeof(heap->slab_pages));
+  heap->resv_count = 0;
+  memset(heap->fast, 0, sizeof(heap->fast));
+  heap->fast_bytes = 0;
+  heap->purge_pending = 0;
+  clock_gettime(CLOCK_MONOTONIC, &heap->purge_last);
+  memset(&heap->stats, 0, sizeof(heap->stats));
   
   if ((extend_heap(CHUNKSIZE/WSIZE)) == NULL)
       return -1;
@@ -149,6 +676,31 @@ int mm_init(void)
 }
 /* $end mminit */
 
+#ifdef THREAD_SAFE
+static void heap0_init(void)
+{
+  if (heap0.listp == 0)
+    mm_init();
+}
+#endif
+
+/*
+ * lazy_init - mm_init the calling thread's heap if nothing has yet. Two
+ *     threads may race here on heap0, so it is initialized just once,
+ *     and neither goes on before that is done.
+ */
+static void lazy_init(void)
+{
+#ifdef THREAD_SAFE
+  if (heap == &heap0) {
+    pthread_once(&heap0_once, heap0_init);
+    return;
+  }
+#endif
+  if (heap->listp == 0)
+    mm_init();
+}
+
 /*
  * malloc - Allocate a block with at least size bytes of payload 
  */
@@ -156,35 +708,45 @@ int mm_init(void)
 void *mm_malloc(size_t size)
 {
   size_t asize;      /* adjusted block size */
-  size_t extendsize; /* amount to extend heap if no fit */
   char *bp;      
-  if (heap_listp == 0){
-    mm_init();
-  }
+  lazy_init();
 
   /* Ignore spurious requests */
   if (size <= 0)
     return NULL;
 
-  /* Adjust block size to include overhead and alignment reqs. */
-  if (size <= MINPAYLOAD)
-    asize = MINPAYLOAD + OVERHEAD;
-  else
-    asize = DSIZE * ((size + (OVERHEAD) + (DSIZE-1)) / DSIZE);
+  /* Large requests get a region of their own; the rest must fit a tag */
+  if (WANT_MAP(size))
+    return map_block(size, ALIGNMENT);
+  if (size > MAX_REQUEST)
+    return NULL;
 
-  /* Search the free list for a fit */
-  if ((bp = find_fit(asize)) != NULL) {
-    place(bp, asize);
+  /* Small requests come from slab pages once their class is in demand */
+  if (slab_enabled && size <= SLAB_MAXSIZE &&
+      DEMAND_INC(heap->slab_demand[slab_class[(size + DSIZE-1) / DSIZE]], 1)
+      >= slab_threshold) {
+    int cls = slab_class[(size + DSIZE-1) / DSIZE];
+#ifdef THREAD_SAFE
+    if (TC_HEAP())
+      return tc_alloc(TC_SLAB_BIN(cls), 0);
+#endif
+    LOCK();
+    bp = slab_alloc(cls);
+    UNLOCK();
     return bp;
   }
 
-  /* No fit found. Get more memory and place the block */
-  extendsize = MAX(asize,CHUNKSIZE);
-  if ((bp = extend_heap(extendsize/WSIZE)) == NULL)
-    return NULL;
-  place(bp, asize);
+  /* Adjust block size to include overhead and alignment reqs. */
+  asize = ADJUST(size);
 
-  //mm_checkheap(0);
+#ifdef THREAD_SAFE
+  if (asize <= TC_MAXSIZE && TC_HEAP())
+    return tc_alloc(TC_BIN(asize), asize);
+#endif
+
+  LOCK();
+  bp = malloc_block(asize);
+  UNLOCK();
   return bp;
 } 
 /* $end mmmalloc */
@@ -197,27 +759,77 @@ void mm_free(void *bp)
 {
   if (bp == 0) return;
 
-  size_t size = GET_SIZE(HDRP(bp));
-  if (heap_listp == 0) {
-    mm_init();
-  }
+  lazy_init();
 
-  PUT(HDRP(bp), PACK(size, 0));
-  PUT(FTRP(bp), PACK(size, 0));
-  coalesce(bp);
-  //mm_checkheap(0);
+  free_payload(bp, is_slab(bp));
 }
 
 /* $end mmfree */
 
 /*
- * realloc - Change the size of the block by mallocing a new block,
- *      copying its data, and freeing the old block.  I'm too lazy
- *      to do better.
+ * free_sized - Free a block the caller knows was asked for with size
+ *      bytes (or anything up to its mm_usable_size). This is mm_free with
+ *      one shortcut: nothing bigger than SLAB_MAXSIZE lives on a slab
+ *      page, so the slab bitmap lookup is skipped for those. The size
+ *      cannot pick the rest of the path. realloc shrinks blocks and slab
+ *      objects in place, so their class and tcache bin can be bigger than
+ *      size says; a block may be GROWN; and M_MMAP_THRESHOLD may have
+ *      changed since the block was allocated. The header is read as in
+ *      mm_free.
+ */
+void mm_free_sized(void *bp, size_t size)
+{
+  if (bp == 0) return;
+
+  lazy_init();
+
+  free_payload(bp, size <= SLAB_MAXSIZE && is_slab(bp));
+}
+
+/*
+ * free_payload - Free the block bp, a slab object if slab is set
+ */
+static void free_payload(void *bp, int slab)
+{
+  if (!slab && IS_MAPPED(bp)) {
+    LOCK();
+    mem_unmap(MAP_BASE(bp));
+    UNLOCK();
+    return;
+  }
+
+  /* a cached block must not come back out still marked as growing */
+  if (!slab && GET_GROWN(HDRP(bp))) {
+    LOCK();
+    resv_drop(bp);
+    CLR_GROWN(HDRP(bp));
+    UNLOCK();
+  }
+
+#ifdef THREAD_SAFE
+  if (slab && TC_HEAP()) {
+    tc_free(TC_SLAB_BIN(SLAB_OF(bp)->cls), bp);
+    return;
+  }
+  if (!slab && GET_SIZE(HDRP(bp)) <= TC_MAXSIZE && TC_HEAP()) {
+    tc_free(TC_BIN(GET_SIZE(HDRP(bp))), bp);
+    return;
+  }
+#endif
+
+  LOCK();
+  release_block(bp);
+  UNLOCK();
+}
+
+/*
+ * realloc - Change the size of the block in place when its neighbours
+ *      (or the top of the heap) allow it; otherwise malloc a new block,
+ *      copy the data and free the old block.
  */
 void *mm_realloc(void *oldptr, size_t size)
 {
-  size_t oldsize;
+  size_t oldsize, asize, want, need;
   void *newptr;
 
   /* If size == 0 then this is just free, and we return NULL. */
@@ -231,43 +843,1632 @@ void *mm_realloc(void *oldptr, size_t size)
     return mm_malloc(size);
   }
 
-  newptr = mm_malloc(size);
+  /* A mapped block that stays large is remapped, never copied */
+  if (!is_slab(oldptr) && IS_MAPPED(oldptr) && WANT_MAP(size)) {
+    oldsize = block_payload(oldptr);
+    if ((newptr = remap_block(oldptr, size)) != NULL)
+      count_realloc(0, MIN(size, oldsize));
+    return newptr;
+  }
+  if (size > MAX_REQUEST && !WANT_MAP(size))
+    return NULL;
+
+  /* A slab object that stays in its size class does not move */
+  if (is_slab(oldptr) && slab_enabled && size <= SLAB_MAXSIZE &&
+      slab_class[(size + DSIZE-1) / DSIZE] == SLAB_OF(oldptr)->cls) {
+    count_realloc(0, MIN(size, SLAB_OF(oldptr)->osize));
+    return oldptr;
+  }
+
+  asize = ADJUST(size);
+  want = 0;
+  if (!is_slab(oldptr) && !IS_MAPPED(oldptr) && !WANT_MAP(size)) {
+    LOCK();
+    oldsize = PAYLOAD_SIZE(oldptr);
+    need = GET_GROWN(HDRP(oldptr)) ? resv_drop(oldptr) : 0;
+
+    /* still growing into the headroom reserved last time */
+    if (need && need <= asize && asize <= GET_SIZE(HDRP(oldptr))) {
+      resv_add(oldptr, asize);
+      UNLOCK();
+      count_realloc(0, MIN(size, oldsize));
+      return oldptr;
+    }
+
+    /* grown before and growing again: ask for headroom */
+    if (asize > GET_SIZE(HDRP(oldptr)) && resv_enabled &&
+        GET_GROWN(HDRP(oldptr)) && asize < MAX_REQUEST / 2)
+      want = RESV_SIZE(asize);
+
+    if ((newptr = (want ? realloc_block(oldptr, want) : NULL)) == NULL)
+      newptr = realloc_block(oldptr, asize);
+
+    /* a neighbour sitting in a fast bin may be all that is in the way */
+    if (newptr == NULL && heap->fast_bytes > 0) {
+      consolidate();
+      newptr = realloc_block(oldptr, asize);
+    }
+    if (newptr != NULL) {
+      if (asize > oldsize + OVERHEAD) {
+        SET_GROWN(HDRP(newptr));
+        if (GET_SIZE(HDRP(newptr)) - asize >= MINBLOCK && !resv_add(newptr, asize))
+          shrink_block(newptr, asize);
+      }
+      UNLOCK();
+      count_realloc(newptr != oldptr, MIN(size, oldsize));
+      return newptr;
+    }
+
+    /* the block stays put for now, headroom and all, until mm_malloc
+       below has found it a new home */
+    if (need)
+      resv_add(oldptr, need);
+    UNLOCK();
+  }
+
+  newptr = mm_malloc(want ? want - OVERHEAD : size);
+
+  /* If realloc() fails the original block is left untouched  */
+  if(!newptr) {
+    return 0;
+  }
+
+  /* Copy the old data. */
+  oldsize = block_payload(oldptr);
+  if(size < oldsize) oldsize = size;
+  memcpy(newptr, oldptr, oldsize);
+  count_realloc(1, oldsize);
+
+  /* Remember that the new block is growing, and list its headroom */
+  if (!is_slab(newptr) && !IS_MAPPED(newptr) && size > oldsize) {
+    LOCK();
+    SET_GROWN(HDRP(newptr));
+    if (want && !resv_add(newptr, asize))
+      shrink_block(newptr, asize);
+    UNLOCK();
+  }
+
+  /* Free the old block. */
+  mm_free(oldptr);
+
+  return newptr;
+}
+
+/*
+ * calloc - Allocate the block and set it to zero.
+ */
+void *mm_calloc (size_t nmemb, size_t size)
+{
+  size_t bytes = nmemb * size;
+  size_t asize;
+  void *newptr;
+
+  if (size != 0 && nmemb > (size_t)-1 / size)
+    return NULL;
+
+  lazy_init();
+
+  /* a fresh region is zero already */
+  if (WANT_MAP(bytes))
+    return map_block(bytes, ALIGNMENT);
+  if (bytes > MAX_REQUEST)
+    return NULL;
+  asize = ADJUST(bytes);
+
+  /* Small requests come from slab pages and caches, and are cheap to clear */
+#ifdef THREAD_SAFE
+  if (known_zero && bytes > SLAB_MAXSIZE && asize <= TC_MAXSIZE &&
+      TC_HEAP() && (newptr = tc_pop(TC_BIN(asize))) != NULL) {
+    memset(newptr, 0, bytes);
+    return newptr;
+  }
+#endif
+  if (!known_zero || bytes <= SLAB_MAXSIZE) {
+    newptr = mm_malloc(bytes);
+    if (newptr != NULL)
+      memset(newptr, 0, bytes);
+    return newptr;
+  }
+
+  LOCK();
+  newptr = calloc_block(asize, bytes);
+  UNLOCK();
+  return newptr;
+}
+
+/*
+ * memalign - Allocate a block with at least size bytes of payload at an
+ *      address that is a multiple of alignment (a power of two). The
+ *      slack in front of and behind it goes back to the free lists.
+ */
+void *mm_memalign(size_t alignment, size_t size)
+{
+  char *bp;
+
+  if (alignment == 0 || (alignment & (alignment-1))) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (alignment <= ALIGNMENT)
+    return mm_malloc(size);
+
+  lazy_init();
+  if (size <= 0)
+    return NULL;
+  if (WANT_MAP(size))
+    return map_block(size, alignment);
+  if (size > MAX_REQUEST || alignment > MAX_REQUEST ||
+      size + alignment > MAX_REQUEST - MINBLOCK)
+    return NULL;
+
+  LOCK();
+  bp = malloc_aligned_block(ADJUST(size), alignment);
+  UNLOCK();
+  return bp;
+}
+
+/*
+ * aligned_alloc - C11 spelling of memalign
+ */
+void *mm_aligned_alloc(size_t alignment, size_t size)
+{
+  return mm_memalign(alignment, size);
+}
+
+/*
+ * posix_memalign - memalign that reports failure by its return value.
+ *      alignment must also be a multiple of sizeof(void *).
+ */
+int mm_posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+  void *bp;
+
+  if (alignment < sizeof(void *) || (alignment & (alignment-1)))
+    return EINVAL;
+  if (size == 0) {
+    *memptr = NULL;
+    return 0;
+  }
+  if ((bp = mm_memalign(alignment, size)) == NULL)
+    return ENOMEM;
+  *memptr = bp;
+  return 0;
+}
+
+/*
+ * usable_size - Return how many bytes the caller may use at bp, which
+ *      is at least what it asked for. Headroom reserved for realloc can
+ *      be trimmed off again, so it does not count.
+ */
+size_t mm_usable_size(void *bp)
+{
+  size_t psize;
+  int i;
+
+  if (bp == NULL)
+    return 0;
+
+  psize = block_payload(bp);
+  if (!is_slab(bp) && !IS_MAPPED(bp) && GET_GROWN(HDRP(bp))) {
+    LOCK();
+    for (i = 0; i < heap->resv_count; i++)
+      if (heap->resv[i].bp == bp)
+        psize = heap->resv[i].asize - OVERHEAD;
+    UNLOCK();
+  }
+  return psize;
+}
+
+/*
+ * good_size - Return the payload a request of size bytes is sure to get,
+ *      or 0 if it cannot be served. Asking for that much from the start
+ *      costs no more memory than asking for size.
+ */
+size_t mm_good_size(size_t size)
+{
+  size_t psize;
+
+  if (size == 0)
+    return 0;
+  if (WANT_MAP(size)) {
+    if (size > (size_t)-1 - MAP_HDR - mem_pagesize())
+      return 0;
+    return MAP_END(MAP_HDR + size) - MAP_HDR;
+  }
+  if (size > MAX_REQUEST)
+    return 0;
+
+  /* a small request may get a slab object instead of a heap block */
+  psize = ADJUST(size) - OVERHEAD;
+  if (slab_enabled && size <= SLAB_MAXSIZE)
+    psize = MIN(psize, slab_size[slab_class[(size + DSIZE-1) / DSIZE]]);
+  return psize;
+}
+
+/*
+ * malloc_batch - Allocate n blocks of size bytes each into out[] and
+ *      return how many were allocated, fewer than n only if memory runs
+ *      out. Heap blocks are carved back to back from as few free blocks
+ *      as possible, all under one lock.
+ */
+size_t mm_malloc_batch(size_t size, size_t n, void **out)
+{
+  size_t asize, k = 0;
+  char *bp;
+  int cls, slab;
+
+  lazy_init();
+  if (size <= 0 || n == 0)
+    return 0;
+
+  /* Large requests get a region each */
+  if (WANT_MAP(size) || size > MAX_REQUEST) {
+    while (k < n && (out[k] = mm_malloc(size)) != NULL)
+      k++;
+    return k;
+  }
+
+  LOCK();
+  if (slab_enabled && size <= SLAB_MAXSIZE) {
+    cls = slab_class[(size + DSIZE-1) / DSIZE];
+    slab = DEMAND_INC(heap->slab_demand[cls], (int)n) >= slab_threshold;
+    if (slab) {
+      while (k < n && (out[k] = slab_alloc(cls)) != NULL)
+        k++;
+      UNLOCK();
+      return k;
+    }
+  }
+
+  asize = ADJUST(size);
+  while (k < n && (bp = fit_run(asize, n - k)) != NULL)
+    k += carve_blocks(bp, asize, n - k, out + k);
+  UNLOCK();
+  return k;
+}
+
+/*
+ * free_batch - Free the n blocks in ptrs[] under one lock. ptrs is
+ *      sorted by address first, so that each run of blocks lying back to
+ *      back is freed and coalesced as a single block.
+ */
+void mm_free_batch(void **ptrs, size_t n)
+{
+  size_t i, j, size;
+  char *bp;
+
+  lazy_init();
+
+  qsort(ptrs, n, sizeof(void *), addr_cmp);
+
+  LOCK();
+  for (i = 0; i < n; i = j) {
+    bp = ptrs[i];
+    j = i + 1;
+    if (bp == NULL)
+      continue;
+    if (is_slab(bp)) {
+      slab_free(bp);
+      continue;
+    }
+    if (IS_MAPPED(bp)) {
+      mem_unmap(MAP_BASE(bp));
+      continue;
+    }
+
+    /* take in the blocks that follow bp directly */
+    size = GET_SIZE(HDRP(bp));
+    if (GET_GROWN(HDRP(bp)))
+      resv_drop(bp);
+    for (; j < n && (char *)ptrs[j] == bp + size; j++) {
+      if (GET_GROWN(HDRP(ptrs[j])))
+        resv_drop(ptrs[j]);
+      size += GET_SIZE(HDRP(ptrs[j]));
+    }
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)) | 1));
+    free_block(bp);
+  }
+  UNLOCK();
+}
+
+/*
+ * mallopt - Set one of the M_xxx tuning parameters declared in mm.h.
+ */
+int mm_mallopt(int param, int value)
+{
+  switch (param) {
+  case M_SLAB:
+    slab_enabled = (value != 0);
+    return 1;
+  case M_SLAB_THRESHOLD:
+    if (value < 0)
+      return 0;
+    slab_threshold = value;
+    return 1;
+  case M_REALLOC_RESERVE:
+    resv_enabled = (value != 0);
+    return 1;
+  case M_KNOWN_ZERO:
+    known_zero = (value != 0);
+    return 1;
+  case M_TRIM_THRESHOLD:
+    if (value < 0)
+      return 0;
+    trim_threshold = value;
+    return 1;
+  case M_PURGE_BATCH:
+    if (value < 0)
+      return 0;
+    purge_batch = value;
+    return 1;
+  case M_PURGE_DELAY:
+    if (value < 0)
+      return 0;
+    purge_delay = value;
+    return 1;
+  case M_MMAP_THRESHOLD:
+    if (value < 0)
+      return 0;
+    mmap_threshold = value;
+    return 1;
+  case M_FAST:
+    fast_enabled = (value != 0);
+    return 1;
+  case M_FAST_MAXSIZE:
+    if (value < 0 || value > FAST_LIMIT)
+      return 0;
+    fast_maxsize = value;
+    return 1;
+  case M_FAST_CONSOLIDATE:
+    if (value < 0)
+      return 0;
+    fast_consolidate = value;
+    return 1;
+#ifndef TLSF
+  case M_TREE:
+    tree_enabled = (value != 0);
+    return 1;
+  case M_ADDR_FIT:
+    addr_enabled = (value != 0);
+    return 1;
+#endif
+  default:
+    return 0;
+  }
+}
+
+/**********************************************************************/
+/**********************************************************************/
+/**********************************************************************/
+
+/* The remaining routines are internal helper routines */
+
+/*
+ * map_block - Allocate a block with size bytes of payload, aligned to
+ *     align (a power of two), in a region of its own
+ */
+static void *map_block(size_t size, size_t align)
+{
+  size_t slack = (align > MAP_HDR) ? align : 0;
+  char *base, *bp;
+
+  if (size > (size_t)-1 - MAP_HDR - slack - mem_pagesize())
+    return NULL;
+  LOCK();
+  base = mem_map(MAP_HDR + slack + size);
+  UNLOCK();
+  if (base == NULL)
+    return NULL;
+  bp = (char *)(((size_t)base + MAP_HDR + align-1) & ~(align-1));
+  MAP_LEN(bp) = MAP_END(bp + size) - (size_t)MAP_BASE(bp);
+  PUT(HDRP(bp), PACK(0, 1));
+  return bp;
+}
+
+/*
+ * remap_block - Resize the mapped block bp to size bytes of payload.
+ *     Returns its (possibly new) address, or NULL if bp is left as is.
+ */
+static void *remap_block(void *bp, size_t size)
+{
+  char *base;
+
+  if (size > (size_t)-1 - MAP_HDR - mem_pagesize())
+    return NULL;
+  LOCK();
+  base = mem_remap(MAP_BASE(bp), MAP_HDR + size);
+  UNLOCK();
+  if (base == NULL)
+    return NULL;
+  *(size_t *)base = MAP_END(base + MAP_HDR + size) - (size_t)base;
+  return base + MAP_HDR;
+}
+
+/*
+ * block_payload - Return how many payload bytes the block bp has room for
+ */
+static size_t block_payload(void *bp)
+{
+  if (is_slab(bp))
+    return SLAB_OF(bp)->osize;
+  if (IS_MAPPED(bp))
+    return MAP_LEN(bp) - MAP_HDR;
+  return PAYLOAD_SIZE(bp);
+}
+
+/*
+ * malloc_block - Allocate a block of asize bytes from its fast bin or the
+ *     shared free lists, extending the heap if nothing fits. Caller
+ *     holds the lock.
+ */
+static void *malloc_block(size_t asize)
+{
+  char *bp;
+
+  if (asize <= FAST_LIMIT && (bp = heap->fast[FAST_BIN(asize)]) != NULL) {
+    heap->fast[FAST_BIN(asize)] = (char *)GET_ADDR(bp);
+    heap->fast_bytes -= asize;
+    heap->stats.fast_hits++;
+    return bp;
+  }
+  if ((bp = fit_block(asize)) != NULL)
+    bp = place(bp, asize);
+  return bp;
+}
+
+/*
+ * fit_block - Find a free block of at least asize bytes, extending the
+ *     heap if nothing fits, but do not place it yet. Caller holds the
+ *     lock.
+ */
+static void *fit_block(size_t asize)
+{
+  size_t extendsize; /* amount to extend heap if no fit */
+  char *bp;
+
+  /* Search the free list for a fit */
+  if ((bp = find_fit(asize)) != NULL)
+    return bp;
+
+  /* Merge what the fast bins hold */
+  if (heap->fast_bytes > 0) {
+    consolidate();
+    if ((bp = find_fit(asize)) != NULL)
+      return bp;
+  }
+
+  /* Give back realloc headroom before asking for more memory */
+  if (heap->resv_count > 0) {
+    resv_reclaim();
+    if ((bp = find_fit(asize)) != NULL)
+      return bp;
+  }
+
+  /* No fit found. Get more memory */
+  extendsize = MAX(asize,CHUNKSIZE);
+  return extend_heap(extendsize/WSIZE);
+}
+
+/*
+ * fit_run - Find a free block for a run of count blocks of asize bytes:
+ *     one that holds them all, else the first that holds one, else a
+ *     single heap extension big enough for all of them. Caller holds the
+ *     lock.
+ */
+static void *fit_run(size_t asize, size_t count)
+{
+  size_t want;
+  char *bp;
+
+  count = MIN(count, MAX_REQUEST / asize);
+  want = asize * count;
+  if ((bp = find_fit(want)) != NULL || (bp = find_fit(asize)) != NULL)
+    return bp;
+
+  /* Merge what the fast bins hold */
+  if (heap->fast_bytes > 0) {
+    consolidate();
+    if ((bp = find_fit(want)) != NULL || (bp = find_fit(asize)) != NULL)
+      return bp;
+  }
+
+  /* Give back realloc headroom before asking for more memory */
+  if (heap->resv_count > 0) {
+    resv_reclaim();
+    if ((bp = find_fit(asize)) != NULL)
+      return bp;
+  }
+
+  if ((bp = extend_heap(MAX(want, CHUNKSIZE)/WSIZE)) != NULL)
+    return bp;
+  return extend_heap(MAX(asize, CHUNKSIZE)/WSIZE);
+}
+
+/*
+ * carve_blocks - Cut as many of count blocks of asize bytes as fit out
+ *     of the free block bp, storing them in out[], and return how many
+ *     that was. A tail too small to stand as a free block goes with the
+ *     last one. Caller holds the lock.
+ */
+static size_t carve_blocks(void *bp, size_t asize, size_t count, void **out)
+{
+  size_t csize = GET_SIZE(HDRP(bp));
+  size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+  size_t zero = GET_ZERO(HDRP(bp));
+  size_t k, m = MIN(count, csize / asize);
+  char *p = bp;
+
+  remove_free(bp);
+  for (k = 0; k < m; k++, p += asize) {
+    PUT(HDRP(p), PACK(asize, prev_alloc | 1));
+    prev_alloc = PREV_ALLOC;
+    out[k] = p;
+  }
+
+  csize -= m * asize;
+  if (csize >= MINBLOCK) {
+    PUT(HDRP(p), PACK(csize, PREV_ALLOC | zero));
+    PUT(FTRP(p), PACK(csize, 0));
+    insert_free(p);
+  }
+  else {
+    p = out[m-1];
+    PUT(HDRP(p), PACK(asize + csize, GET_PREV_ALLOC(HDRP(p)) | 1));
+    SET_PREV_ALLOC(HDRP(NEXT_BLKP(p)));
+  }
+  return m;
+}
+
+/*
+ * addr_cmp - qsort order of two block pointers by address
+ */
+static int addr_cmp(const void *a, const void *b)
+{
+  const char *p = *(char * const *)a, *q = *(char * const *)b;
+
+  return (p > q) - (p < q);
+}
+
+/*
+ * calloc_block - Allocate a block of asize bytes whose first bytes of
+ *     payload read as zero. A block known to be zero only needs its list
+ *     links and footer cleared. Caller holds the lock.
+ */
+static void *calloc_block(size_t asize, size_t bytes)
+{
+  size_t csize;
+  int zero;
+  char *bp, *abp;
+
+  if ((bp = fit_block(asize)) == NULL)
+    return NULL;
+  csize = GET_SIZE(HDRP(bp));
+  zero = known_zero && GET_ZERO(HDRP(bp));
+  abp = place(bp, asize);
+
+  if (!zero) {
+    memset(abp, 0, bytes);
+    return abp;
+  }
+  if (abp == bp)
+    memset(bp, 0, MINPAYLOAD);     // the list links, unless they went with the split
+  if (abp != bp || GET_SIZE(HDRP(bp)) == csize)
+    PUT(bp + csize - 2*TSIZE, 0);  // the footer, likewise
+  return abp;
+}
+
+/*
+ * free_block - Return an allocated block to the shared free lists.
+ *     Caller holds the lock.
+ */
+static void free_block(void *bp)
+{
+  size_t size = GET_SIZE(HDRP(bp));
+
+  PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp))));
+  PUT(FTRP(bp), PACK(size, 0));
+  CLR_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+  bp = coalesce(bp);
+  size = GET_SIZE(HDRP(bp));
+  if (size > trim_threshold + TRIM_PAD && GET_SIZE(HDRP(NEXT_BLKP(bp))) == 0) {
+    trim_top(TRIM_PAD);
+    return;
+  }
+  if (size >= PURGE_MIN && (heap->purge_pending += size) >= purge_batch &&
+      purge_due())
+    purge_free();
+  //mm_checkheap(0);
+}
+
+/*
+ * purge_due - Whether purge_delay ms have passed since the last pass
+ */
+static int purge_due(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - heap->purge_last.tv_sec) * 1000 +
+    (now.tv_nsec - heap->purge_last.tv_nsec) / 1000000 >= purge_delay;
+}
+
+/*
+ * purge_free - Purge every free block of at least PURGE_MIN bytes that
+ *     is not known to be zero. Caller holds the lock.
+ */
+static void purge_free(void)
+{
+  char *bp;
+
+#ifdef TLSF
+  int fl, sl;
+
+  tlsf_mapping(PURGE_MIN, &fl, &sl);
+  for ( ; fl < FL_COUNT; fl++)
+    for (sl = 0; sl < SL_COUNT; sl++)
+      for (bp = ROOT_LIST(&heap->tlsf_head[fl][sl]); bp != NULL; bp = NEXT_FREE(bp))
+        purge_block(bp);
+#else
+  char *list_ptr;
+
+  if (heap->addr)
+    addr_purge(ROOT_LIST(ADDR_ROOT));
+  else {
+    for (list_ptr = indirection(PURGE_MIN); list_ptr <= heap->saveroot+0x50; list_ptr += 0x8)
+      if (heap->tree && list_ptr == TREE_ROOT)
+        tree_purge(ROOT_LIST(list_ptr));
+      else
+        for (bp = ROOT_LIST(list_ptr); bp != NULL; bp = NEXT_FREE(bp))
+          purge_block(bp);
+  }
+#endif
+  heap->purge_pending = 0;
+  clock_gettime(CLOCK_MONOTONIC, &heap->purge_last);
+}
+
+/*
+ * purge_block - Give the interior pages of the free block bp back and
+ *     clear the rest of its payload, making it a ZERO block
+ */
+static void purge_block(void *bp)
+{
+  char *links = (char *)bp + LINKBYTES(bp); /* first byte free to purge */
+  char *footer = FTRP(bp);
+  char *lo = (char *)(((size_t)links + SLAB_PAGE-1) & ~(size_t)(SLAB_PAGE-1));
+  char *hi = (char *)((size_t)footer & ~(size_t)(SLAB_PAGE-1));
+
+  if (GET_SIZE(HDRP(bp)) < PURGE_MIN || GET_ZERO(HDRP(bp)) || hi <= lo)
+    return;
+  mem_purge(lo, hi - lo);
+  memset(links, 0, lo - links);
+  memset(hi, 0, footer - hi);
+  PUT(HDRP(bp), GET(HDRP(bp)) | ZERO);
+  heap->stats.purged_bytes += hi - lo;
+}
+
+/*
+ * trim_top - If the last block in the heap is free, give all but pad
+ *     bytes of it back to memlib. Returns whether anything was released.
+ *     Caller holds the lock.
+ */
+static int trim_top(size_t pad)
+{
+  char *brk = (char *)mem_heap_hi() + 1;  /* epilogue block pointer */
+  char *bp;
+  size_t size, keep, zero;
+
+  if (GET_PREV_ALLOC(HDRP(brk)))
+    return 0;
+  bp = PREV_BLKP(brk);
+  size = GET_SIZE(HDRP(bp));
+  zero = GET_ZERO(HDRP(bp));
+
+  keep = ALIGN(pad);
+  if (keep > 0 && keep < MINBLOCK)
+    keep = MINBLOCK;
+  if (keep + DSIZE > size)
+    return 0;
+
+  remove_free(bp);
+  if (keep == 0) {
+    /* the whole block goes; its header becomes the epilogue */
+    PUT(HDRP(bp), PACK(0, PREV_ALLOC | 1));
+  }
+  else {
+    PUT(HDRP(bp), PACK(keep, PREV_ALLOC | zero));
+    PUT(FTRP(bp), PACK(keep, 0));
+    insert_free(bp);
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));
+  }
+  mem_sbrk(-(intptr_t)(size - keep));
+  return 1;
+}
+
+/*
+ * mm_trim - Give free memory at the top of the heap back, keeping pad
+ *     bytes of it, and purge the large free blocks inside the heap.
+ *     Returns 1 if the heap was shrunk, 0 otherwise.
+ */
+int mm_trim(size_t pad)
+{
+  int released;
+
+  LOCK();
+  if (heap->listp == 0) {
+    UNLOCK();
+    return 0;
+  }
+  consolidate();
+  released = trim_top(pad);
+  purge_free();
+  UNLOCK();
+  return released;
+}
+
+/*
+ * release_block - Free either a slab object or a heap block, putting a
+ *     small heap block in its fast bin. Caller holds the lock.
+ */
+static void release_block(void *bp)
+{
+  if (is_slab(bp))
+    slab_free(bp);
+  else if (fast_enabled && GET_SIZE(HDRP(bp)) <= fast_maxsize)
+    fast_free(bp);
+  else
+    free_block(bp);
+}
+
+/*
+ * fast_free - Put the allocated block bp in the fast bin of its size,
+ *     consolidating if the bins hold too much. Caller holds the lock.
+ */
+static void fast_free(void *bp)
+{
+  size_t size = GET_SIZE(HDRP(bp));
+
+  PUT_ADDR(bp, heap->fast[FAST_BIN(size)]);
+  heap->fast[FAST_BIN(size)] = bp;
+  if ((heap->fast_bytes += size) > fast_consolidate)
+    consolidate();
+}
+
+/*
+ * consolidate - Free every block in the fast bins, coalescing each with
+ *     its free neighbours. Caller holds the lock.
+ */
+static void consolidate(void)
+{
+  char *bp, *next;
+  int b;
+
+  if (heap->fast_bytes == 0)
+    return;
+  for (b = 0; b < FAST_BINS; b++) {
+    for (bp = heap->fast[b]; bp != NULL; bp = next) {
+      next = (char *)GET_ADDR(bp);
+      free_block(bp);
+    }
+    heap->fast[b] = NULL;
+  }
+  heap->fast_bytes = 0;
+  heap->stats.consolidations++;
+}
+
+/*
+ * realloc_block - Resize the allocated block bp to asize bytes without
+ *     going through malloc. Grows into a free next block, into a free
+ *     previous block (moving the payload down), or by extending the heap
+ *     when bp is the last block; shrinks by splitting off the tail.
+ *     Returns the block's (possibly new) address, or NULL if it cannot be
+ *     resized in place. Caller holds the lock.
+ */
+static void *realloc_block(void *bp, size_t asize)
+{
+  size_t csize = GET_SIZE(HDRP(bp));
+  size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+  char *next = NEXT_BLKP(bp);
+  size_t next_alloc = GET_ALLOC(HDRP(next));
+  size_t next_size = next_alloc ? 0 : GET_SIZE(HDRP(next));
+  size_t shortfall;
+  char *prev;
+
+  if (asize <= csize) {
+    shrink_block(bp, asize);
+    return bp;
+  }
+
+  /* last block in the heap: get just the shortfall from the system */
+  if (GET_SIZE(HDRP(next)) == 0 ||
+      (!next_alloc && GET_SIZE(HDRP(NEXT_BLKP(next))) == 0)) {
+    if (csize + next_size < asize) {
+      shortfall = MAX(asize - csize - next_size, MINBLOCK);
+      if (extend_heap(shortfall/WSIZE) == NULL)
+        return NULL;
+      next_alloc = 0;
+      next_size = GET_SIZE(HDRP(next));
+    }
+  }
+
+  if (csize + next_size >= asize) {            /* absorb next */
+    if (next_size) {
+      remove_free(next);
+      csize += next_size;
+      PUT(HDRP(bp), PACK(csize, prev_alloc | 1));
+      SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+    }
+    shrink_block(bp, asize);
+    return bp;
+  }
+
+  if (!prev_alloc &&                           /* absorb prev (and next) */
+      GET_SIZE(HDRP(PREV_BLKP(bp))) + csize + next_size >= asize) {
+    prev = PREV_BLKP(bp);
+    remove_free(prev);
+    if (next_size)
+      remove_free(next);
+    memmove(prev, bp, csize - OVERHEAD);
+    csize += GET_SIZE(HDRP(prev)) + next_size;
+    PUT(HDRP(prev), PACK(csize, PREV_ALLOC | 1));
+    SET_PREV_ALLOC(HDRP(NEXT_BLKP(prev)));
+    shrink_block(prev, asize);
+    return prev;
+  }
+
+  return NULL;
+}
+
+/*
+ * resv_add - List bp as holding headroom beyond asize bytes. Returns 0
+ *     if the table is full. Caller holds the lock.
+ */
+static int resv_add(void *bp, size_t asize)
+{
+  if (heap->resv_count == RESV_SLOTS)
+    return 0;
+  heap->resv[heap->resv_count].bp = bp;
+  heap->resv[heap->resv_count].asize = asize;
+  heap->resv_count++;
+  return 1;
+}
+
+/*
+ * resv_drop - Take bp off the reservation table. Returns the size it
+ *     was listed as needing, or 0 if it was not listed. Caller holds the
+ *     lock.
+ */
+static size_t resv_drop(void *bp)
+{
+  size_t asize;
+  int i;
+
+  for (i = 0; i < heap->resv_count; i++) {
+    if (heap->resv[i].bp == bp) {
+      asize = heap->resv[i].asize;
+      heap->resv[i] = heap->resv[--heap->resv_count];
+      return asize;
+    }
+  }
+  return 0;
+}
+
+/*
+ * resv_reclaim - Trim every reserved block back to the size it needs.
+ *     Caller holds the lock.
+ */
+static void resv_reclaim(void)
+{
+  resv_t *r;
+
+  while (heap->resv_count > 0) {
+    r = &heap->resv[--heap->resv_count];
+    shrink_block(r->bp, r->asize);
+  }
+}
+
+/*
+ * count_realloc - Account for a realloc that moved (or did not have to
+ *     move) bytes of payload
+ */
+static void count_realloc(int moved, size_t bytes)
+{
+  LOCK();
+  if (moved) {
+    heap->stats.realloc_copies++;
+    heap->stats.copied_bytes += bytes;
+  }
+  else {
+    heap->stats.copies_avoided++;
+    heap->stats.avoided_bytes += bytes;
+  }
+  UNLOCK();
+}
+
+/*
+ * mm_get_stats - Copy out the counters gathered since mm_init
+ */
+void mm_get_stats(mm_stats_t *st)
+{
+  LOCK();
+  *st = heap->stats;
+  UNLOCK();
+}
+
+/*
+ * shrink_block - Give the tail of the allocated block bp beyond asize
+ *     bytes back to the free lists, if it is big enough to be a block.
+ */
+static void shrink_block(void *bp, size_t asize)
+{
+  size_t csize = GET_SIZE(HDRP(bp));
+  char *tail;
+
+  if (csize - asize < MINBLOCK)
+    return;
+  PUT(HDRP(bp), PACK(asize, (GET(HDRP(bp)) & (PREV_ALLOC | GROWN)) | 1));
+  tail = NEXT_BLKP(bp);
+  PUT(HDRP(tail), PACK(csize - asize, PREV_ALLOC | 1));
+  free_block(tail);
+}
+
+/*
+ * malloc_aligned_block - Like malloc_block, but the payload address is a
+ *     multiple of align (a power of two). The slack in front of the
+ *     aligned payload and any unused tail go back to the free lists.
+ *     Caller holds the lock.
+ */
+static void *malloc_aligned_block(size_t asize, size_t align)
+{
+  char *bp, *abp, *tail;
+  size_t csize, lead;
+
+  if ((bp = malloc_block(asize + align + MINBLOCK)) == NULL)
+    return NULL;
+  csize = GET_SIZE(HDRP(bp));
+
+  /* the leading fragment must be big enough to stand as a free block */
+  if (((size_t)bp & (align-1)) == 0)
+    abp = bp;
+  else
+    abp = (char *)(((size_t)bp + MINBLOCK + align-1) & ~(align-1));
+  if (abp != bp) {
+    lead = abp - bp;
+    PUT(HDRP(abp), PACK(csize - lead, PREV_ALLOC | 1));
+    PUT(HDRP(bp), PACK(lead, GET_PREV_ALLOC(HDRP(bp)) | 1));
+    free_block(bp);
+    csize -= lead;
+  }
+
+  if (csize - asize >= MINBLOCK) {
+    PUT(HDRP(abp), PACK(asize, GET_PREV_ALLOC(HDRP(abp)) | 1));
+    tail = NEXT_BLKP(abp);
+    PUT(HDRP(tail), PACK(csize - asize, PREV_ALLOC | 1));
+    free_block(tail);
+  }
+  return abp;
+}
+
+/**********************************************************************/
+// Heaps
+
+/*
+ * mm_heap_create - Make an empty heap with a memlib instance of its own.
+ *     Returns NULL if there is no room for one.
+ */
+mm_heap_t *mm_heap_create(void)
+{
+  mem_heap_t *m, *oldmem;
+  mm_heap_t *h, *old = heap;
+
+  if ((m = mem_create()) == NULL)
+    return NULL;
+  oldmem = mem_use(m);
+  if ((h = mem_map(sizeof(mm_heap_t))) != NULL) {
+    h->mem = m;
+#ifdef THREAD_SAFE
+    pthread_mutex_init(&h->lock, NULL);
+#endif
+    heap = h;
+    if (mm_init() < 0)
+      h = NULL;
+    heap = old;
+  }
+  mem_use(oldmem);
+  if (h == NULL)
+    mem_destroy(m);
+  return h;
+}
+
+/*
+ * mm_heap_destroy - Drop heap h and every block in it at once. The
+ *     default heap cannot be destroyed, and no thread may be using h.
+ */
+void mm_heap_destroy(mm_heap_t *h)
+{
+  if (h == NULL || h == &heap0)
+    return;
+  if (heap == h)
+    mm_heap_use(NULL);
+#ifdef THREAD_SAFE
+  pthread_mutex_destroy(&h->lock);
+#endif
+  mem_destroy(h->mem);  /* h itself lives in one of its regions */
+}
+
+/*
+ * mm_heap_use - Make the calling thread's mm_xxx calls work on heap h
+ *     (the default heap if NULL) and return the heap they worked on.
+ */
+mm_heap_t *mm_heap_use(mm_heap_t *h)
+{
+  mm_heap_t *old = heap;
+
+  heap = (h != NULL) ? h : &heap0;
+  mem_use(heap->mem);
+  return old;
+}
+
+/*
+ * mm_heap_malloc, mm_heap_free, mm_heap_realloc, mm_heap_calloc - The
+ *     calls of the same name, on heap h
+ */
+void *mm_heap_malloc(mm_heap_t *h, size_t size)
+{
+  mm_heap_t *old = mm_heap_use(h);
+  void *bp = mm_malloc(size);
+
+  mm_heap_use(old);
+  return bp;
+}
+
+void mm_heap_free(mm_heap_t *h, void *bp)
+{
+  mm_heap_t *old = mm_heap_use(h);
+
+  mm_free(bp);
+  mm_heap_use(old);
+}
+
+void *mm_heap_realloc(mm_heap_t *h, void *oldptr, size_t size)
+{
+  mm_heap_t *old = mm_heap_use(h);
+  void *bp = mm_realloc(oldptr, size);
+
+  mm_heap_use(old);
+  return bp;
+}
+
+void *mm_heap_calloc(mm_heap_t *h, size_t nmemb, size_t size)
+{
+  mm_heap_t *old = mm_heap_use(h);
+  void *bp = mm_calloc(nmemb, size);
+
+  mm_heap_use(old);
+  return bp;
+}
+
+/**********************************************************************/
+// Region arenas
+
+/*
+ * mm_arena_create - Start an arena whose chunks are chunk bytes (0 for
+ *     the default). Returns NULL if the first chunk cannot be had.
+ */
+mm_arena_t *mm_arena_create(size_t chunk)
+{
+  arena_chunk_t *c;
+  mm_arena_t *a;
+
+  chunk = chunk ? MAX(ALIGN(chunk), ARENA_MIN) : ARENA_CHUNK;
+  if (chunk > MAX_REQUEST || (c = mm_malloc(chunk)) == NULL)
+    return NULL;
+  c->next = NULL;
+  c->end = (char *)c + chunk;
+
+  a = (mm_arena_t *)((char *)c + ARENA_HDR);
+  a->first = a->cur = c;
+  a->big = NULL;
+  a->brk = (char *)c + ARENA_START;
+  a->chunk = chunk;
+  return a;
+}
+
+/*
+ * mm_arena_alloc - Bump-allocate size bytes from arena a
+ */
+void *mm_arena_alloc(mm_arena_t *a, size_t size)
+{
+  arena_chunk_t *c;
+  char *p;
+
+  if (size == 0 || size > (size_t)-1 - ARENA_HDR - ALIGNMENT)
+    return NULL;
+  size = ALIGN(size);
+
+  if (size <= (size_t)(a->cur->end - a->brk)) {
+    p = a->brk;
+    a->brk += size;
+    return p;
+  }
+
+  /* a big object would waste most of a chunk */
+  if (size > (a->chunk - ARENA_HDR) / 4) {
+    if ((c = mm_malloc(ARENA_HDR + size)) == NULL)
+      return NULL;
+    c->next = a->big;
+    c->end = (char *)c + ARENA_HDR + size;
+    a->big = c;
+    return (char *)c + ARENA_HDR;
+  }
+
+  /* go on to the next chunk, reusing one kept from before a reset */
+  if ((c = a->cur->next) == NULL) {
+    if ((c = mm_malloc(a->chunk)) == NULL)
+      return NULL;
+    c->next = NULL;
+    c->end = (char *)c + a->chunk;
+    a->cur->next = c;
+  }
+  a->cur = c;
+  p = (char *)c + ARENA_HDR;
+  a->brk = p + size;
+  return p;
+}
+
+/*
+ * mm_arena_reset - Free everything allocated from arena a at once
+ */
+void mm_arena_reset(mm_arena_t *a)
+{
+  arena_chunk_t *c;
+
+  while ((c = a->big) != NULL) {
+    a->big = c->next;
+    mm_free(c);
+  }
+  a->cur = a->first;
+  a->brk = (char *)a->first + ARENA_START;
+}
+
+/*
+ * mm_arena_destroy - Free arena a, its chunks and everything in them
+ */
+void mm_arena_destroy(mm_arena_t *a)
+{
+  arena_chunk_t *c, *next;
+
+  mm_arena_reset(a);
+  for (c = a->first; c != NULL; c = next) {
+    next = c->next;
+    mm_free(c);
+  }
+}
+
+/**********************************************************************/
+// Fixed-size object pools
+
+/*
+ * mm_pool_create - Start a pool of obj_size-byte objects aligned to
+ *     align (a power of two, 0 for ALIGNMENT). Returns NULL if align is
+ *     not a power of two or no memory is left.
+ */
+mm_pool_t *mm_pool_create(size_t obj_size, size_t align)
+{
+  mm_pool_t *pool;
+  size_t chunk = POOL_CHUNK;
+
+  align = MAX(align ? align : ALIGNMENT, sizeof(char *));
+  if ((align & (align-1)) || obj_size > MAX_REQUEST / (2*POOL_MINOBJ) ||
+      align > MAX_REQUEST / (2*POOL_MINOBJ))
+    return NULL;
+  if ((pool = mm_malloc(sizeof(mm_pool_t))) == NULL)
+    return NULL;
+
+  pool->osize = (MAX(obj_size, sizeof(char *)) + align-1) & ~(align-1);
+  pool->first = (sizeof(pool_chunk_t) + align-1) & ~(align-1);
+  pool->align = align;
+  while (chunk < pool->first + POOL_MINOBJ * pool->osize)
+    chunk <<= 1;
+  pool->chunk = chunk;
+  pool->nobj = (chunk - pool->first) / pool->osize;
+  pool->chunks = NULL;
+  pool->nchunks = 0;
+  pool->free = NULL;
+  pool->nfree = 0;
+  return pool;
+}
+
+/*
+ * pool_grow - Add a chunk to pool and put all its objects on the free
+ *     list, lowest address first out. Returns 0 if no memory is left.
+ */
+static int pool_grow(mm_pool_t *pool)
+{
+  pool_chunk_t *c;
+  char *p;
+
+  c = (pool->align > ALIGNMENT) ? mm_memalign(pool->align, pool->chunk) :
+    mm_malloc(pool->chunk);
+  if (c == NULL)
+    return 0;
+  c->next = pool->chunks;
+  pool->chunks = c;
+  pool->nchunks++;
+
+  for (p = (char *)c + pool->first + (pool->nobj-1) * pool->osize;
+       p >= (char *)c + pool->first; p -= pool->osize) {
+    PUT_ADDR(p, pool->free);
+    pool->free = p;
+  }
+  pool->nfree += pool->nobj;
+  return 1;
+}
+
+/*
+ * mm_pool_alloc - Take an object from pool, adding a chunk if none is free
+ */
+void *mm_pool_alloc(mm_pool_t *pool)
+{
+  char *p;
+
+  if (pool->free == NULL && !pool_grow(pool))
+    return NULL;
+  p = pool->free;
+  pool->free = (char *)GET_ADDR(p);
+  pool->nfree--;
+  return p;
+}
+
+/*
+ * mm_pool_free - Give object p back to pool
+ */
+void mm_pool_free(mm_pool_t *pool, void *p)
+{
+  if (p == NULL)
+    return;
+  PUT_ADDR(p, pool->free);
+  pool->free = p;
+  pool->nfree++;
+}
+
+/*
+ * mm_pool_reserve - Add chunks until at least n objects are free, so
+ *     that the next n allocations from pool never reach the heap.
+ *     Returns 0 if no memory is left.
+ */
+int mm_pool_reserve(mm_pool_t *pool, size_t n)
+{
+  while (pool->nfree < n)
+    if (!pool_grow(pool))
+      return 0;
+  return 1;
+}
+
+/*
+ * pool_chunk_of - Find the chunk holding object p among the n chunks
+ *     sorted by address in cs[]
+ */
+static pool_chunk_t *pool_chunk_of(mm_pool_t *pool, pool_chunk_t **cs,
+                                   size_t n, const char *p)
+{
+  size_t lo = 0, hi = n, mid;
+
+  while (hi - lo > 1) {
+    mid = (lo + hi) / 2;
+    if ((char *)cs[mid] <= p)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  assert((char *)cs[lo] <= p && p < (char *)cs[lo] + pool->chunk);
+  return cs[lo];
+}
+
+/*
+ * mm_pool_release - Give every chunk of pool with no live objects back
+ *     to the heap. Returns how many chunks that was, or 0 if there is no
+ *     memory to sort the chunks in.
+ */
+size_t mm_pool_release(mm_pool_t *pool)
+{
+  pool_chunk_t **cs, *c;
+  char *p, **pp;
+  size_t i, n = pool->nchunks, released = 0;
+
+  if (pool->nfree < pool->nobj ||
+      (cs = mm_malloc(n * sizeof(pool_chunk_t *))) == NULL)
+    return 0;
+  for (i = 0, c = pool->chunks; c != NULL; c = c->next) {
+    c->nfree = 0;
+    cs[i++] = c;
+  }
+  qsort(cs, n, sizeof(pool_chunk_t *), addr_cmp);
+
+  /* count the free objects of every chunk... */
+  for (p = pool->free; p != NULL; p = (char *)GET_ADDR(p))
+    pool_chunk_of(pool, cs, n, p)->nfree++;
+
+  /* ...take those of the empty chunks off the free list... */
+  for (pp = &pool->free; (p = *pp) != NULL; ) {
+    if (pool_chunk_of(pool, cs, n, p)->nfree == pool->nobj) {
+      *pp = (char *)GET_ADDR(p);
+      pool->nfree--;
+    }
+    else
+      pp = (char **)p;
+  }
+
+  /* ...and free them, keeping the rest in address order */
+  pool->chunks = NULL;
+  for (i = n; i-- > 0; ) {
+    if (cs[i]->nfree == pool->nobj) {
+      mm_free(cs[i]);
+      released++;
+      continue;
+    }
+    cs[i]->next = pool->chunks;
+    pool->chunks = cs[i];
+  }
+  pool->nchunks -= released;
+  mm_free(cs);
+  return released;
+}
+
+/*
+ * mm_pool_destroy - Free pool and every object in it
+ */
+void mm_pool_destroy(mm_pool_t *pool)
+{
+  pool_chunk_t *c, *next;
+
+  for (c = pool->chunks; c != NULL; c = next) {
+    next = c->next;
+    mm_free(c);
+  }
+  mm_free(pool);
+}
+
+/**********************************************************************/
+// Slab pages for small objects
+
+/*
+ * is_slab - Return whether p points into a slab run.
+ */
+static int is_slab(const void *p)
+{
+  size_t i = SLAB_INDEX(p); /* huge if p is below the heap */
+
+  if (i >= sizeof(heap->slab_pages) * 8)
+    return 0;
+  return (heap->slab_pages[i >> 3] >> (i & 7)) & 1;
+}
+
+/*
+ * slab_alloc - Hand out a free object of class cls, starting a new run
+ *     when every run of that class is full. Caller holds the lock.
+ */
+static void *slab_alloc(int cls)
+{
+  slab_t *s = heap->slab_partial[cls];
+  int w, bit;
+
+  if (s == NULL && (s = slab_new(cls)) == NULL)
+    return NULL;
+
+  for (w = 0; ~s->map[w] == 0; w++)
+    ;
+  bit = __builtin_ctzl(~s->map[w]);
+  s->map[w] |= 1UL << bit;
+  if (--s->nfree == 0)
+    slab_unlink(s);
+  return (char *)s + SLAB_HDR + (w*64 + bit) * s->osize;
+}
+
+/*
+ * slab_free - Return object p to its run. A run that becomes empty goes
+ *     back to the heap unless it is the last one of its class with free
+ *     objects. Caller holds the lock.
+ */
+static void slab_free(void *p)
+{
+  slab_t *s = SLAB_OF(p);
+  int idx = ((char *)p - ((char *)s + SLAB_HDR)) / s->osize;
+  size_t i;
+
+  assert (s->map[idx/64] & (1UL << (idx%64)));
+  s->map[idx/64] &= ~(1UL << (idx%64));
+  if (s->nfree++ == 0)
+    slab_link(s);
+
+  if (s->nfree == s->nobj && (s->next != NULL || s->prev != NULL)) {
+    slab_unlink(s);
+    i = SLAB_INDEX(s);
+    heap->slab_pages[i >> 3] &= ~(1 << (i & 7));
+    free_block(s);
+  }
+}
+
+/*
+ * slab_new - Carve a page-aligned run for class cls out of the heap and
+ *     make it the first run on the class's partial list.
+ */
+static slab_t *slab_new(int cls)
+{
+  slab_t *s;
+  size_t i;
+
+  if ((s = malloc_aligned_block(ADJUST(SLAB_PAGE), SLAB_PAGE)) == NULL)
+    return NULL;
+
+  s->osize = slab_size[cls];
+  s->cls = cls;
+  s->nobj = (SLAB_PAGE - SLAB_HDR) / s->osize;
+  s->nfree = s->nobj;
+  /* objects past nobj are permanently "in use" */
+  memset(s->map, 0, sizeof(s->map));
+  for (i = s->nobj; i < SLAB_WORDS*64; i++)
+    s->map[i/64] |= 1UL << (i%64);
+
+  i = SLAB_INDEX(s);
+  heap->slab_pages[i >> 3] |= 1 << (i & 7);
+  slab_link(s);
+  return s;
+}
+
+// Push a run onto the front of its class's partial list
+static void slab_link(slab_t *s)
+{
+  s->prev = NULL;
+  s->next = heap->slab_partial[s->cls];
+  if (s->next != NULL)
+    s->next->prev = s;
+  heap->slab_partial[s->cls] = s;
+}
+
+// Take a run off its class's partial list
+static void slab_unlink(slab_t *s)
+{
+  if (s->prev != NULL)
+    s->prev->next = s->next;
+  else
+    heap->slab_partial[s->cls] = s->next;
+  if (s->next != NULL)
+    s->next->prev = s->prev;
+  s->next = s->prev = NULL;
+}
+
+#ifdef THREAD_SAFE
+/*
+ * tc_get - Return the calling thread's tcache, dropping its contents if
+ *     they were cached before the last mm_init.
+ */
+static tcache_t *tc_get(void)
+{
+  tcache_t *tc = &tcache;
+
+  if (tc->gen != heap_gen) {
+    memset(tc->count, 0, sizeof(tc->count));
+    memset(tc->fill, 0, sizeof(tc->fill));
+    memset(tc->bin, 0, sizeof(tc->bin));
+    tc->gen = heap_gen;
+  }
+  if (!tc->registered) {
+    pthread_once(&tc_key_once, tc_key_init);
+    pthread_setspecific(tc_key, tc);
+    tc->registered = 1;
+  }
+  return tc;
+}
+
+/*
+ * tc_pop - Pop a block from tcache bin b, or return NULL if it is empty.
+ */
+static void *tc_pop(int b)
+{
+  tcache_t *tc = tc_get();
+  char *bp;
+
+  if ((bp = tc->bin[b]) != NULL) {
+    tc->bin[b] = (char *)GET_ADDR(bp);
+    tc->count[b]--;
+  }
+  return bp;
+}
+
+/*
+ * tc_alloc - Pop a block from tcache bin b. When the bin is empty, take
+ *     the lock once and carve blocks (slab objects for the slab bins,
+ *     asize-byte heap blocks otherwise), caching all but one. The first
+ *     refill of a bin carves a single block and each later one twice as
+ *     many, up to TC_REFILL, so a size asked for only once or twice does
+ *     not leave blocks stranded in the cache.
+ */
+static void *tc_alloc(int b, size_t asize)
+{
+  tcache_t *tc;
+  char *bp, *ret;
+  int i;
 
-  /* If realloc() fails the original block is left untouched  */
-  if(!newptr) {
-    return 0;
+  if ((bp = tc_pop(b)) != NULL)
+    return bp;
+  tc = &tcache;
+  tc->fill[b] = tc->fill[b] ? MIN(2 * tc->fill[b], TC_REFILL) : 1;
+
+  LOCK();
+  for (i = 0, ret = NULL; i < tc->fill[b]; i++) {
+    if (b >= TC_BINS)
+      bp = slab_alloc(b - TC_BINS);
+    else
+      bp = malloc_block(asize);
+    if (bp == NULL)
+      break;
+    if (ret == NULL) {
+      ret = bp;
+      continue;
+    }
+    PUT_ADDR(bp, tc->bin[b]);
+    tc->bin[b] = bp;
+    tc->count[b]++;
   }
+  UNLOCK();
+  return ret;
+}
 
-  /* Copy the old data. */
-  oldsize = GET_SIZE(HDRP(oldptr)); 
-  if(size < oldsize) oldsize = size;
-  memcpy(newptr, oldptr, oldsize);
-
-  /* Free the old block. */
-  mm_free(oldptr);
+/*
+ * tc_free - Push a block onto tcache bin b, first flushing half the bin
+ *     to the shared heap if it is full.
+ */
+static void tc_free(int b, void *bp)
+{
+  tcache_t *tc = tc_get();
 
-  return newptr;
+  if (tc->count[b] >= TC_COUNT)
+    tc_flush(tc, b, TC_COUNT/2);
+  PUT_ADDR(bp, tc->bin[b]);
+  tc->bin[b] = bp;
+  tc->count[b]++;
 }
 
 /*
- * calloc - Allocate the block and set it to zero.
+ * tc_flush - Give all but keep blocks of tcache bin b back to the shared
+ *     free lists under a single lock acquisition.
  */
-void *mm_calloc (size_t nmemb, size_t size)
+static void tc_flush(tcache_t *tc, int b, int keep)
 {
-  size_t bytes = nmemb * size;
-  void *newptr;
-
-  newptr = mm_malloc(bytes);
-  memset(newptr, 0, bytes);
+  char *bp;
 
-  return newptr;
+  LOCK();
+  while (tc->count[b] > keep) {
+    bp = tc->bin[b];
+    tc->bin[b] = (char *)GET_ADDR(bp);
+    tc->count[b]--;
+    release_block(bp);
+  }
+  UNLOCK();
 }
 
-/**********************************************************************/
-/**********************************************************************/
-/**********************************************************************/
+/*
+ * tc_destroy - Thread-exit destructor: flush everything the exiting
+ *     thread still caches so the blocks are not lost to the heap.
+ */
+static void tc_destroy(void *arg)
+{
+  tcache_t *tc = arg;
+  int b;
 
-/* The remaining routines are internal helper routines */
+  if (tc->gen != heap_gen)
+    return;
+  mm_heap_use(NULL);
+  for (b = 0; b < TC_NBINS; b++)
+    if (tc->count[b] > 0)
+      tc_flush(tc, b, 0);
+}
+
+static void tc_key_init(void)
+{
+  pthread_key_create(&tc_key, tc_destroy);
+}
+#endif
 
 /* 
  * extend_heap - Extend heap with free block and return its block pointer
@@ -275,17 +2476,18 @@ void *mm_calloc (size_t nmemb, size_t size)
 /* $begin mmextendheap */
 static void *extend_heap(size_t words) 
 {
-  char *bp;
-  size_t size;
+  char *bp, *clean = mem_clean_lo();
+  size_t size, zero;
   void *return_ptr;
 
-  /* Allocate an even number of words to maintain alignment */
-  size = (words % 2) ? (words+1) * WSIZE : words * WSIZE;
+  /* Allocate whole multiples of ALIGNMENT to maintain alignment */
+  size = ALIGN(words * WSIZE);
   if ((long)(bp = mem_sbrk(size)) < 0) 
     return NULL;
+  zero = (clean <= bp) ? ZERO : 0;  // only memory never handed out is zero
 
   /* Initialize free block header/footer and the epilogue header */
-  PUT(HDRP(bp), PACK(size, 0));         /* free block header */
+  PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)) | zero)); /* free block header */
   PUT(FTRP(bp), PACK(size, 0));         /* free block footer */
   PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* new epilogue header */
 
@@ -298,46 +2500,94 @@ static void *extend_heap(size_t words)
 /* $end mmextendheap */
 
 /* 
- * place - Place block of asize bytes at start of free block bp 
- *         and split if remainder would be at least minimum block size
+ * place - Place block of asize bytes in free block bp and split if the
+ *         remainder would be at least minimum block size. Blocks of
+ *         PLACE_BACK bytes or more go at the end of bp and smaller ones at
+ *         the start, so that large and small blocks gather apart and the
+ *         holes large blocks leave can merge. Returns the block placed.
  */
 /* $begin mmplace */
 /* $begin mmplace-proto */
-static void place(void *bp, size_t asize)
+static void *place(void *bp, size_t asize)
   /* $end mmplace-proto */
 {
   size_t csize = GET_SIZE(HDRP(bp));  
+  size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+  size_t zero = GET_ZERO(HDRP(bp));
   char *split_bp; 
   size_t split_size;
-  char *list_ptr = indirection(csize);
 
-  PUT(HDRP(bp), PACK(csize, 1));
-  PUT(FTRP(bp), PACK(csize, 1));
+  remove_free(bp);
 
-  if ((csize - asize) >= (MINPAYLOAD + OVERHEAD)) {
+  if ((csize - asize) >= MINBLOCK && asize >= PLACE_BACK) {
+      split_size = csize-asize;
+      PUT(HDRP(bp), PACK(split_size, prev_alloc | zero));
+      PUT(FTRP(bp), PACK(split_size, 0));
+      insert_free(bp);
+
+      bp = NEXT_BLKP(bp);
       PUT(HDRP(bp), PACK(asize, 1));
-      PUT(FTRP(bp), PACK(asize, 1));
+      SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+  }
+  else if ((csize - asize) >= MINBLOCK) {
+      PUT(HDRP(bp), PACK(asize, prev_alloc | 1));
 
-      dbll_remove(list_ptr, bp);
       split_bp = NEXT_BLKP(bp);
       split_size = csize-asize;
-      PUT(HDRP(split_bp), PACK(split_size, 0));
+      PUT(HDRP(split_bp), PACK(split_size, PREV_ALLOC | zero));
       PUT(FTRP(split_bp), PACK(split_size, 0));
-      // find new list for the split block
-      list_ptr = indirection(split_size);
-      dbll_insert_at_root(list_ptr, split_bp);
+      // file the split block under its new size
+      insert_free(split_bp);
   }
   else {
-      PUT(HDRP(bp), PACK(csize, 1));
-      PUT(HDRP(bp), PACK(csize, 1));
-
-      dbll_remove(list_ptr, bp);
+      PUT(HDRP(bp), PACK(csize, prev_alloc | 1));
+      SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
   }
+  return bp;
 }
 /* $end mmplace */
 
+#ifdef TLSF
+/*
+ * find_fit - Find a fit for a block with asize bytes. The head of asize's
+ * own list is tried first; failing that, asize is rounded up to the next
+ * class boundary so that any block in the first non-empty list at or above
+ * it fits. Both steps take constant time.
+ */
+static void *find_fit(size_t asize)
+{
+  int fl, sl;
+  unsigned int map;
+  unsigned long fmap;
+  char *bp;
+
+  tlsf_mapping(asize, &fl, &sl);
+  if ((bp = ROOT_LIST(&heap->tlsf_head[fl][sl])) != NULL &&
+      GET_SIZE(HDRP(bp)) >= asize)
+    return bp;
+
+  if (asize >= TLSF_SMALL)
+    asize += ((size_t)1 << (63 - __builtin_clzl(asize) - SL_BITS)) - 1;
+  tlsf_mapping(asize, &fl, &sl);
+  if (fl >= FL_COUNT)
+    return NULL;
+
+  map = heap->sl_bitmap[fl] & (~0U << sl);
+  if (map == 0) {
+    fmap = (fl + 1 < FL_COUNT) ? heap->fl_bitmap & (~0UL << (fl + 1)) : 0;
+    if (fmap == 0)
+      return NULL; // not found
+    fl = __builtin_ctzl(fmap);
+    map = heap->sl_bitmap[fl];
+  }
+  sl = __builtin_ctz(map);
+  return ROOT_LIST(&heap->tlsf_head[fl][sl]);
+}
+#else
 /* 
- * find_fit - Find a fit for a block with asize bytes 
+ * find_fit - Find a fit for a block with asize bytes. The lists are
+ * searched first fit; the size tree, if any, comes last, best fit, or
+ * the address index, lowest address first.
  */
 static void *find_fit(size_t asize)
 {
@@ -345,7 +2595,8 @@ static void *find_fit(size_t asize)
   char *check_singleton;
   char *start_list_ptr = indirection(asize);
   char *list_ptr, *list;
-  char *end_list_ptr = saveroot+0x50;
+  char *end_list_ptr = heap->addr ? ADDR_ROOT-0x8 :
+                       heap->tree ? TREE_ROOT-0x8 : TREE_ROOT;
 
   for (list_ptr = start_list_ptr; list_ptr <= end_list_ptr; list_ptr += 0x8) {
     list = ROOT_LIST(list_ptr);
@@ -368,116 +2619,521 @@ static void *find_fit(size_t asize)
     }
     // else continue onto other lists
   }
-  return NULL; // not found
+  if (heap->addr)
+    return addr_fit(asize);
+  return heap->tree ? tree_fit(asize) : NULL;
 }
+#endif
 
 /*
  * coalesce - boundary tag coalescing. Return ptr to coalesced block
  */
 static void *coalesce(void *bp) 
 {
-  size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
+  size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
   size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
   size_t size = GET_SIZE(HDRP(bp));
-  size_t prev_size, next_size;
-  char *list_ptr = indirection(size);
-  char *list = ROOT_LIST(list_ptr);
-  char *prev, *next, *list_ptr_prev, *list_ptr_next;
-
-  /* initiate list on first call to extend_heap */
-  if (list == 0x0) {
-    dbll_init(list_ptr, bp);
-    return bp;
-  }
+  size_t zero = GET_ZERO(HDRP(bp));
+  char *prev, *next;
 
   /* heap_extend, Case 3; free, any Case */
   if (prev_alloc && next_alloc) {            /* Case 1 */
-    dbll_insert_at_root(list_ptr, bp);
+    insert_free(bp);
     return bp;
   }
 
   else if (prev_alloc && !next_alloc) {      /* Case 2 */
     next = NEXT_BLKP(bp);
     assert (next != NULL);
-    next_size = GET_SIZE(HDRP(next));
-    list_ptr_next = indirection(next_size);
-    dbll_remove(list_ptr_next, next);
-
-    size += next_size;
-    PUT(HDRP(bp), PACK(size, 0));
-    PUT(FTRP(bp), PACK(size,0));
+    remove_free(next);
+    zero &= GET_ZERO(HDRP(next));
 
-    list_ptr = indirection(size);
-    dbll_insert_at_root(list_ptr, bp);
+    size += GET_SIZE(HDRP(next));
+    if (zero)  // the tags and links between the two are now payload
+      memset(next - 2*TSIZE, 0, 2*TSIZE + MINPAYLOAD);
+    PUT(HDRP(bp), PACK(size, PREV_ALLOC | zero));
+    PUT(FTRP(bp), PACK(size, 0));
   }
 
   else if (!prev_alloc && next_alloc) {      /* Case 3 */
     prev = PREV_BLKP(bp);
     assert (prev != NULL);
-    prev_size = GET_SIZE(HDRP(prev));
-    list_ptr_prev = indirection(prev_size);
-    dbll_remove(list_ptr_prev, prev);
+    remove_free(prev);
+    zero &= GET_ZERO(HDRP(prev));
 
-    size += prev_size;
+    size += GET_SIZE(HDRP(prev));
     PUT(FTRP(bp), PACK(size, 0));
-    PUT(HDRP(prev), PACK(size, 0));
+    PUT(HDRP(prev), PACK(size, PREV_ALLOC | zero));
+    if (zero)  // only once FTRP(bp) has been found through bp's header
+      memset((char *)bp - 2*TSIZE, 0, 2*TSIZE + MINPAYLOAD);
     bp = prev;
-
-    list_ptr = indirection(size);
-    dbll_insert_at_root(list_ptr, bp);
   }
 
   else {                                     /* Case 4 */
     prev = PREV_BLKP(bp);
     next = NEXT_BLKP(bp);
     assert (prev != NULL && next != NULL);
+    remove_free(prev);
+    remove_free(next);
+    zero &= GET_ZERO(HDRP(prev)) & GET_ZERO(HDRP(next));
 
-    prev_size = GET_SIZE(HDRP(prev));
-    list_ptr_prev = indirection(prev_size);
-    dbll_remove(list_ptr_prev, prev);
-
-    next_size = GET_SIZE(HDRP(next));
-    list_ptr_next = indirection(next_size);
-    dbll_remove(list_ptr_next, next);
-
-    size += prev_size + next_size;
-    PUT(HDRP(prev), PACK(size, 0));
+    size += GET_SIZE(HDRP(prev)) + GET_SIZE(HDRP(next));
+    PUT(HDRP(prev), PACK(size, PREV_ALLOC | zero));
     PUT(FTRP(next), PACK(size, 0));
+    if (zero) {
+      memset((char *)bp - 2*TSIZE, 0, 2*TSIZE + MINPAYLOAD);
+      memset(next - 2*TSIZE, 0, 2*TSIZE + MINPAYLOAD);
+    }
     bp = prev;
-
-    list_ptr = indirection(size);
-    dbll_insert_at_root(list_ptr, bp);
   }
 
+  insert_free(bp);
   return bp;
 }
 
+#ifdef TLSF
+/*
+ * tlsf_mapping - first- and second-level index of the list for size
+ */
+static void tlsf_mapping(size_t size, int *fl, int *sl)
+{
+  int msb;
+
+  if (size < TLSF_SMALL) {
+    *fl = 0;
+    *sl = size / DSIZE;
+  }
+  else {
+    msb = 63 - __builtin_clzl(size);
+    *fl = msb - TLSF_SHIFT + 1;
+    *sl = (size >> (msb - SL_BITS)) ^ SL_COUNT;
+  }
+}
+
+/*
+ * insert_free/remove_free - file bp under its header size, or take it
+ * back out, keeping the bitmaps in step with the lists
+ */
+static void insert_free(void *bp)
+{
+  int fl, sl;
+
+  tlsf_mapping(GET_SIZE(HDRP(bp)), &fl, &sl);
+  dbll_insert_at_root(&heap->tlsf_head[fl][sl], bp);
+  heap->sl_bitmap[fl] |= 1U << sl;
+  heap->fl_bitmap |= 1UL << fl;
+}
+
+static void remove_free(void *bp)
+{
+  int fl, sl;
+
+  tlsf_mapping(GET_SIZE(HDRP(bp)), &fl, &sl);
+  dbll_remove(&heap->tlsf_head[fl][sl], bp);
+  if (ROOT_LIST(&heap->tlsf_head[fl][sl]) == NULL) {
+    heap->sl_bitmap[fl] &= ~(1U << sl);
+    if (heap->sl_bitmap[fl] == 0)
+      heap->fl_bitmap &= ~(1UL << fl);
+  }
+}
+#else
 static void *indirection(size_t size)
 {
   assert (size >= 0);
   if (size < (1<<5))
-    return ((char *)saveroot);
+    return ((char *)heap->saveroot);
   else if (size < (1<<6))
-    return ((char *)saveroot+0x8);
+    return ((char *)heap->saveroot+0x8);
   else if (size < (1<<7))
-    return ((char *)saveroot+0x10);
+    return ((char *)heap->saveroot+0x10);
   else if (size < (1<<8))
-    return ((char *)saveroot+0x18);
+    return ((char *)heap->saveroot+0x18);
   else if (size < (1<<9))
-    return ((char *)saveroot+0x20);
+    return ((char *)heap->saveroot+0x20);
   else if (size < (1<<10))
-    return ((char *)saveroot+0x28);
+    return ((char *)heap->saveroot+0x28);
   else if (size < (1<<11))
-    return ((char *)saveroot+0x30);
+    return ((char *)heap->saveroot+0x30);
   else if (size < (1<<12))
-    return ((char *)saveroot+0x38);
+    return ((char *)heap->saveroot+0x38);
   else if (size < (1<<13))
-    return ((char *)saveroot+0x40);
+    return ((char *)heap->saveroot+0x40);
   else if (size < (1<<14))
-    return ((char *)saveroot+0x48);
+    return ((char *)heap->saveroot+0x48);
+  else
+    return ((char *)heap->saveroot+0x50);
+}
+
+/*
+ * insert_free/remove_free - file bp under its header size, or take it
+ * back out
+ */
+static void insert_free(void *bp)
+{
+  size_t size = GET_SIZE(HDRP(bp));
+
+  if (heap->addr && size >= ADDR_MIN)
+    PUT_ADDR(ADDR_ROOT, addr_insert(ROOT_LIST(ADDR_ROOT), bp));
+  else if (heap->tree && size >= TREE_MIN)
+    PUT_ADDR(TREE_ROOT, tree_insert(ROOT_LIST(TREE_ROOT), bp, size));
+  else
+    dbll_insert_at_root(indirection(size), bp);
+}
+
+static void remove_free(void *bp)
+{
+  size_t size = GET_SIZE(HDRP(bp));
+
+  if (heap->addr && size >= ADDR_MIN) {
+    PUT_ADDR(ADDR_ROOT, addr_delete(ROOT_LIST(ADDR_ROOT), bp));
+    memset(AMAX_PTR(bp), 0, ADDR_BYTES);
+  }
+  else if (heap->tree && size >= TREE_MIN) {
+    tree_remove(bp, size);
+    memset(LEFT_PTR(bp), 0, TREE_BYTES);
+  }
   else
-    return ((char *)saveroot+0x50);
+    dbll_remove(indirection(size), bp);
+}
+
+/**********************************************************************/
+// Size tree for the blocks of TREE_MIN bytes and up
+// Each function returns the new root of the subtree it was given
+
+// Rotate right if t and its left child are on the same level
+static char *tree_skew(char *t)
+{
+  char *l;
+
+  if (t == NULL || LEFT(t) == NULL || LEVEL(LEFT(t)) != LEVEL(t))
+    return t;
+  l = LEFT(t);
+  PUT_LINK(LEFT_PTR(t), RIGHT(l));
+  PUT_LINK(RIGHT_PTR(l), t);
+  return l;
+}
+
+// Rotate left and raise the middle node if t has two right children
+// on its level
+static char *tree_split(char *t)
+{
+  char *r;
+
+  if (t == NULL || RIGHT(t) == NULL || LEVEL(RIGHT(RIGHT(t))) != LEVEL(t))
+    return t;
+  r = RIGHT(t);
+  PUT_LINK(RIGHT_PTR(t), LEFT(r));
+  PUT_LINK(LEFT_PTR(r), t);
+  *LEVEL_PTR(r) += 1;
+  return r;
+}
+
+// Add bp, of size bytes, as a new leaf or to the chain of its size
+static char *tree_insert(char *t, char *bp, size_t size)
+{
+  size_t tsize;
+  char *next;  /* next in t's chain, or t's new child */
+
+  if (t == NULL) {
+    PUT_LINK(PREV_PTR(bp), NULL);
+    PUT_LINK(NEXT_PTR(bp), NULL);
+    PUT_LINK(LEFT_PTR(bp), NULL);
+    PUT_LINK(RIGHT_PTR(bp), NULL);
+    *LEVEL_PTR(bp) = 1;
+    return bp;
+  }
+  tsize = GET_SIZE(HDRP(t));
+  if (size == tsize) {  // just behind t, which stays in the tree
+    next = NEXT_FREE(t);
+    PUT_LINK(PREV_PTR(bp), t);
+    PUT_LINK(NEXT_PTR(bp), next);
+    if (next != NULL)
+      PUT_LINK(PREV_PTR(next), bp);
+    PUT_LINK(NEXT_PTR(t), bp);
+    return t;
+  }
+  if (size < tsize) {
+    next = tree_insert(LEFT(t), bp, size);
+    PUT_LINK(LEFT_PTR(t), next);
+  }
+  else {
+    next = tree_insert(RIGHT(t), bp, size);
+    PUT_LINK(RIGHT_PTR(t), next);
+  }
+  return tree_split(tree_skew(t));
+}
+
+// Take the node of size bytes, whose chain is empty, out of the tree
+static char *tree_delete(char *t, size_t size)
+{
+  size_t tsize;
+  unsigned int level;
+  char *s, *r;
+
+  if (t == NULL)
+    return NULL;
+  tsize = GET_SIZE(HDRP(t));
+  if (size < tsize) {
+    s = tree_delete(LEFT(t), size);
+    PUT_LINK(LEFT_PTR(t), s);
+  }
+  else if (size > tsize) {
+    r = tree_delete(RIGHT(t), size);
+    PUT_LINK(RIGHT_PTR(t), r);
+  }
+  else if (LEFT(t) == NULL)
+    return RIGHT(t);  // t is on level 1, so this is a leaf or nothing
+  else {
+    // the next larger node takes t's place
+    for (s = RIGHT(t); LEFT(s) != NULL; s = LEFT(s))
+      ;
+    r = tree_delete(RIGHT(t), GET_SIZE(HDRP(s)));
+    PUT_LINK(RIGHT_PTR(t), r);
+    PUT_LINK(LEFT_PTR(s), LEFT(t));
+    PUT_LINK(RIGHT_PTR(s), RIGHT(t));
+    *LEVEL_PTR(s) = *LEVEL_PTR(t);
+    t = s;
+  }
+
+  // a level may have been lost below t
+  level = MIN(LEVEL(LEFT(t)), LEVEL(RIGHT(t))) + 1;
+  if (level < LEVEL(t)) {
+    *LEVEL_PTR(t) = level;
+    if (level < LEVEL(RIGHT(t)))
+      *LEVEL_PTR(RIGHT(t)) = level;
+  }
+  t = tree_skew(t);
+  r = tree_skew(RIGHT(t));
+  PUT_LINK(RIGHT_PTR(t), r);
+  if (r != NULL) {
+    s = tree_skew(RIGHT(r));
+    PUT_LINK(RIGHT_PTR(r), s);
+  }
+  t = tree_split(t);
+  r = tree_split(RIGHT(t));
+  PUT_LINK(RIGHT_PTR(t), r);
+  return t;
+}
+
+// Take bp, of size bytes, out of its chain or out of the tree
+static void tree_remove(char *bp, size_t size)
+{
+  char *prev = PREV_FREE(bp);
+  char *next = NEXT_FREE(bp);
+  char *t, *link;
+
+  if (prev != NULL) {  // behind the node of its size
+    PUT_LINK(NEXT_PTR(prev), next);
+    if (next != NULL)
+      PUT_LINK(PREV_PTR(next), prev);
+    return;
+  }
+  if (next == NULL) {  // the last block of its size
+    PUT_ADDR(TREE_ROOT, tree_delete(ROOT_LIST(TREE_ROOT), size));
+    return;
+  }
+
+  // next takes bp's place in the tree, under the same parent
+  PUT_LINK(PREV_PTR(next), NULL);
+  PUT_LINK(LEFT_PTR(next), LEFT(bp));
+  PUT_LINK(RIGHT_PTR(next), RIGHT(bp));
+  *LEVEL_PTR(next) = *LEVEL_PTR(bp);
+  if ((t = ROOT_LIST(TREE_ROOT)) == bp) {
+    PUT_ADDR(TREE_ROOT, next);
+    return;
+  }
+  for (;;) {
+    link = size < GET_SIZE(HDRP(t)) ? LEFT_PTR(t) : RIGHT_PTR(t);
+    if (GET_LINK(link) == bp)
+      break;
+    t = GET_LINK(link);
+  }
+  PUT_LINK(link, next);
+}
+
+// Find the smallest free block of at least asize bytes. A block behind
+// the node is taken in preference, as it leaves the tree alone.
+static char *tree_fit(size_t asize)
+{
+  char *t = ROOT_LIST(TREE_ROOT);
+  char *best = NULL;
+  size_t tsize;
+
+  while (t != NULL) {
+    tsize = GET_SIZE(HDRP(t));
+    if (tsize < asize)
+      t = RIGHT(t);
+    else {
+      best = t;
+      if (tsize == asize)
+        break;
+      t = LEFT(t);
+    }
+  }
+  if (best != NULL && NEXT_FREE(best) != NULL)
+    return NEXT_FREE(best);
+  return best;
+}
+
+// Purge every block in the tree
+static void tree_purge(char *t)
+{
+  char *bp;
+
+  if (t == NULL)
+    return;
+  for (bp = t; bp != NULL; bp = NEXT_FREE(bp))
+    purge_block(bp);
+  tree_purge(LEFT(t));
+  tree_purge(RIGHT(t));
+}
+
+/**********************************************************************/
+// Address index for the blocks of ADDR_MIN bytes and up
+// The same AA tree, keyed by address, with each node's subtree maximum
+
+// Recompute the largest size under t from its children
+static void addr_fix(char *t)
+{
+  size_t max = GET_SIZE(HDRP(t));
+
+  max = MAX(max, AMAX(ALEFT(t)));
+  max = MAX(max, AMAX(ARIGHT(t)));
+  PUT(AMAX_PTR(t), max);
+}
+
+static char *addr_skew(char *t)
+{
+  char *l;
+
+  if (t == NULL || ALEFT(t) == NULL || ALEVEL(ALEFT(t)) != ALEVEL(t))
+    return t;
+  l = ALEFT(t);
+  PUT_LINK(PREV_PTR(t), ARIGHT(l));
+  PUT_LINK(NEXT_PTR(l), t);
+  addr_fix(t);
+  addr_fix(l);
+  return l;
+}
+
+static char *addr_split(char *t)
+{
+  char *r;
+
+  if (t == NULL || ARIGHT(t) == NULL || ALEVEL(ARIGHT(ARIGHT(t))) != ALEVEL(t))
+    return t;
+  r = ARIGHT(t);
+  PUT_LINK(NEXT_PTR(t), ALEFT(r));
+  PUT_LINK(PREV_PTR(r), t);
+  *ALEVEL_PTR(r) += 1;
+  addr_fix(t);
+  addr_fix(r);
+  return r;
+}
+
+// Add bp as a new leaf
+static char *addr_insert(char *t, char *bp)
+{
+  char *c;
+
+  if (t == NULL) {
+    PUT_LINK(PREV_PTR(bp), NULL);
+    PUT_LINK(NEXT_PTR(bp), NULL);
+    PUT(AMAX_PTR(bp), GET_SIZE(HDRP(bp)));
+    *ALEVEL_PTR(bp) = 1;
+    return bp;
+  }
+  if (bp < t) {
+    c = addr_insert(ALEFT(t), bp);
+    PUT_LINK(PREV_PTR(t), c);
+  }
+  else {
+    c = addr_insert(ARIGHT(t), bp);
+    PUT_LINK(NEXT_PTR(t), c);
+  }
+  addr_fix(t);
+  return addr_split(addr_skew(t));
+}
+
+// Take bp out of the tree
+static char *addr_delete(char *t, char *bp)
+{
+  unsigned int level;
+  char *s, *r;
+
+  if (t == NULL)
+    return NULL;
+  if (bp < t) {
+    s = addr_delete(ALEFT(t), bp);
+    PUT_LINK(PREV_PTR(t), s);
+  }
+  else if (bp > t) {
+    r = addr_delete(ARIGHT(t), bp);
+    PUT_LINK(NEXT_PTR(t), r);
+  }
+  else if (ALEFT(t) == NULL)
+    return ARIGHT(t);  // t is on level 1, so this is a leaf or nothing
+  else {
+    // the next node up the heap takes t's place
+    for (s = ARIGHT(t); ALEFT(s) != NULL; s = ALEFT(s))
+      ;
+    r = addr_delete(ARIGHT(t), s);
+    PUT_LINK(NEXT_PTR(t), r);
+    PUT_LINK(PREV_PTR(s), ALEFT(t));
+    PUT_LINK(NEXT_PTR(s), ARIGHT(t));
+    *ALEVEL_PTR(s) = *ALEVEL_PTR(t);
+    t = s;
+  }
+  addr_fix(t);
+
+  // a level may have been lost below t
+  level = MIN(ALEVEL(ALEFT(t)), ALEVEL(ARIGHT(t))) + 1;
+  if (level < ALEVEL(t)) {
+    *ALEVEL_PTR(t) = level;
+    if (level < ALEVEL(ARIGHT(t)))
+      *ALEVEL_PTR(ARIGHT(t)) = level;
+  }
+  t = addr_skew(t);
+  r = addr_skew(ARIGHT(t));
+  PUT_LINK(NEXT_PTR(t), r);
+  if (r != NULL) {
+    s = addr_skew(ARIGHT(r));
+    PUT_LINK(NEXT_PTR(r), s);
+  }
+  t = addr_split(t);
+  r = addr_split(ARIGHT(t));
+  PUT_LINK(NEXT_PTR(t), r);
+  return t;
+}
+
+// Find the lowest-addressed free block of at least asize bytes
+static char *addr_fit(size_t asize)
+{
+  char *t = ROOT_LIST(ADDR_ROOT);
+
+  if (AMAX(t) < asize)
+    return NULL;
+  for (;;) {
+    if (AMAX(ALEFT(t)) >= asize)
+      t = ALEFT(t);
+    else if (GET_SIZE(HDRP(t)) >= asize)
+      return t;
+    else
+      t = ARIGHT(t);
+  }
+}
+
+// Purge every block in the tree, skipping the subtrees with none big
+// enough to be worth it
+static void addr_purge(char *t)
+{
+  if (AMAX(t) < PURGE_MIN)
+    return;
+  purge_block(t);
+  addr_purge(ALEFT(t));
+  addr_purge(ARIGHT(t));
 }
+#endif
 
 /**********************************************************************/
 // Helpers for doubly linked list
@@ -487,8 +3143,8 @@ static void *indirection(size_t size)
 // set root to the chunk created in the first call to expend_heap
 static void dbll_init(void *list_ptr, void *bp)
 {
-  PUT_ADDR(PREV_PTR(bp), 0x0); // bp->prev = NULL
-  PUT_ADDR(NEXT_PTR(bp), 0x0); // bp->next = NULL
+  PUT_LINK(PREV_PTR(bp), NULL); // bp->prev = NULL
+  PUT_LINK(NEXT_PTR(bp), NULL); // bp->next = NULL
   PUT_ADDR(list_ptr, bp); // root points to the newest free block
 }
 
@@ -506,9 +3162,9 @@ static void dbll_insert_at_root(void *list_ptr, void *bp)
 
   char *savebp = root; // save the old block root pointed to
 
-  PUT_ADDR(PREV_PTR(savebp), bp); // savebp->prev = bp;
-  PUT_ADDR(PREV_PTR(bp), 0x0); // bp->prev = NULL
-  PUT_ADDR(NEXT_PTR(bp), savebp); // bp->next = savebp
+  PUT_LINK(PREV_PTR(savebp), bp); // savebp->prev = bp;
+  PUT_LINK(PREV_PTR(bp), NULL); // bp->prev = NULL
+  PUT_LINK(NEXT_PTR(bp), savebp); // bp->next = savebp
   PUT_ADDR(list_ptr, bp); // root now points to the newest free block
 }
 // Remove a block from the root of the list
@@ -522,7 +3178,7 @@ static void dbll_remove_at_root(void *list_ptr, void *bp)
     PUT_ADDR(list_ptr, 0x0);
     return NULL;
   }
-  PUT_ADDR(PREV_PTR(next), 0x0);
+  PUT_LINK(PREV_PTR(next), NULL);
   PUT_ADDR(list_ptr, next); // root = bp->next
 }
 // Remove a block from either the root or the middle of the list
@@ -541,14 +3197,14 @@ static void dbll_remove(void *list_ptr, void *bp)
       PUT_ADDR(list_ptr, 0x0);
       return NULL;
     }
-    PUT_ADDR(PREV_PTR(next), 0x0);
+    PUT_LINK(PREV_PTR(next), NULL);
     PUT_ADDR(list_ptr, next); // root = bp->next
   }
 
   if (prev != NULL)
-    PUT_ADDR(NEXT_PTR(prev), next); // bp->prev->next = bp->next
+    PUT_LINK(NEXT_PTR(prev), next); // bp->prev->next = bp->next
   if (next != NULL)
-    PUT_ADDR(PREV_PTR(next), prev); // bp->next->prev = bp->prev
+    PUT_LINK(PREV_PTR(next), prev); // bp->next->prev = bp->prev
   // don't move the root!
 }
 
@@ -560,20 +3216,27 @@ static void dbll_remove(void *list_ptr, void *bp)
  */
 void mm_checkheap(int verbose)
 {
-  char *bp = heap_listp;
+  char *bp = heap->listp;
 
+  LOCK();
   if (verbose)
-    printf("\nHeap (%p):\n", heap_listp);
+    printf("\nHeap (%p):\n", heap->listp);
 
-  if ((GET_SIZE(HDRP(heap_listp)) != DSIZE) || !GET_ALLOC(HDRP(heap_listp)))
+  if ((GET_SIZE(HDRP(heap->listp)) != PROLOGUE) || !GET_ALLOC(HDRP(heap->listp)))
     printf("Bad prologue header\n");
-  checkblock(heap_listp);
+  checkblock(heap->listp);
 
-  for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+  for (bp = heap->listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
     if (verbose)  {
       printblock(bp);
     }
     checkblock(bp);
+    // the next header must know whether this block is allocated
+    if (!GET_PREV_ALLOC(HDRP(NEXT_BLKP(bp))) != !GET_ALLOC(HDRP(bp)))
+      printf("Error: prev-alloc bit after %p is wrong\n", bp);
+    if (!GET_ALLOC(HDRP(bp)) && !GET_ALLOC(HDRP(NEXT_BLKP(bp))))
+      printf("Error: free blocks %p and %p escaped coalescing\n",
+             bp, NEXT_BLKP(bp));
   }
 
   if (verbose) {
@@ -583,28 +3246,44 @@ void mm_checkheap(int verbose)
     printf("Bad epilogue header\n");
   
   if (verbose) {
-    char *root = ROOT_LIST(saveroot);
+    char *root = ROOT_LIST(heap->saveroot);
     printlist(root);
   }
+  checkslabs();
+  checkresv();
+  checkfast();
+#ifdef TLSF
+  checkindex();
+#else
+  if (heap->addr)
+    checkaddr(ROOT_LIST(ADDR_ROOT), NULL, NULL);
+  else if (heap->tree) {
+    checktree(ROOT_LIST(TREE_ROOT), 0, (size_t)-1);
+    if (ROOT_LIST(TREE_ROOT) != NULL && PREV_FREE(ROOT_LIST(TREE_ROOT)) != NULL)
+      printf("Error: tree root %p has a prev link\n", ROOT_LIST(TREE_ROOT));
+  }
+#endif
+  UNLOCK();
 }
 
 static void printblock(void *bp) 
 {
-  size_t hsize, halloc, fsize, falloc;
+  size_t hsize, halloc, palloc;
 
   hsize = GET_SIZE(HDRP(bp));
   halloc = GET_ALLOC(HDRP(bp));  
-  fsize = GET_SIZE(FTRP(bp));
-  falloc = GET_ALLOC(FTRP(bp));  
+  palloc = GET_PREV_ALLOC(HDRP(bp));
 
   if (hsize == 0) {
     printf("%p: EOL\n", bp);
     return;
   }
 
-  printf("%p: header: [%p:%c] footer: [%p:%c]\n", bp, 
-    hsize, (halloc ? 'a' : 'f'), 
-    fsize, (falloc ? 'a' : 'f')); 
+  if (halloc)
+    printf("%p: header: [%zu:a%c]\n", bp, hsize, (palloc ? 'a' : 'f'));
+  else
+    printf("%p: header: [%zu:f%c] footer: [%zu]\n", bp,
+      hsize, (palloc ? 'a' : 'f'), (size_t)GET_SIZE(FTRP(bp)));
   // if (halloc == 0) {
   //   char *prev = PREV_FREE(bp);
   //   char *next = NEXT_FREE(bp);
@@ -614,9 +3293,11 @@ static void printblock(void *bp)
 
 static void checkblock(void *bp) 
 {
-  if ((size_t)bp % 8)
-    printf("Error: %p is not doubleword aligned\n", bp);
-  if (GET(HDRP(bp)) != GET(FTRP(bp)))
+  size_t i, size;
+
+  if ((size_t)bp % ALIGNMENT)
+    printf("Error: %p is not %d-byte aligned\n", bp, ALIGNMENT);
+  if (!GET_ALLOC(HDRP(bp)) && GET_SIZE(HDRP(bp)) != GET_SIZE(FTRP(bp)))
     printf("Error: header does not match footer\n");
   // check prev and next for free block
   if (!GET_ALLOC(HDRP(bp))) {
@@ -630,7 +3311,161 @@ static void checkblock(void *bp)
       assert (in_heap(next));
     }
   }
+  // spot-check the ends of a block that is supposed to be zero
+  if (!GET_ALLOC(HDRP(bp)) && GET_ZERO(HDRP(bp))) {
+    size = GET_SIZE(HDRP(bp)) - 2*TSIZE;
+    for (i = LINKBYTES(bp); i < size; i++) {
+      if (((char *)bp)[i] != 0) {
+        printf("Error: known-zero block %p has byte %zu set\n", bp, i);
+        break;
+      }
+      if (i == LINKBYTES(bp) + 64 && size > i + 64)
+        i = size - 64;
+    }
+  }
+}
+
+// Check that every run on the partial lists is registered and counted right
+static void checkslabs(void)
+{
+  slab_t *s;
+  int cls, w, used;
+
+  for (cls = 0; cls < SLAB_CLASSES; cls++) {
+    for (s = heap->slab_partial[cls]; s != NULL; s = s->next) {
+      if (!is_slab(s) || SLAB_OF(s) != s)
+        printf("Error: slab %p is not a registered page\n", s);
+      if (s->cls != cls || s->osize != slab_size[cls])
+        printf("Error: slab %p is on the wrong class list\n", s);
+      for (w = 0, used = 0; w < SLAB_WORDS; w++)
+        used += __builtin_popcountl(s->map[w]);
+      used -= SLAB_WORDS*64 - s->nobj;
+      if (s->nfree == 0 || used != s->nobj - s->nfree)
+        printf("Error: slab %p has %d objects in use but nfree %d\n",
+               s, used, s->nfree);
+    }
+  }
+}
+
+// Check that every listed reservation is a growing block with headroom
+static void checkresv(void)
+{
+  int i;
+  char *bp;
+
+  for (i = 0; i < heap->resv_count; i++) {
+    bp = heap->resv[i].bp;
+    if (!in_heap(bp) || !GET_ALLOC(HDRP(bp)) || !GET_GROWN(HDRP(bp)))
+      printf("Error: reserved block %p is not a growing block\n", bp);
+    else if (GET_SIZE(HDRP(bp)) < heap->resv[i].asize)
+      printf("Error: reserved block %p is smaller than it needs\n", bp);
+  }
+}
+
+// Check that every fast bin holds allocated blocks of its own size
+static void checkfast(void)
+{
+  size_t bytes = 0;
+  char *bp;
+  int b;
+
+  for (b = 0; b < FAST_BINS; b++)
+    for (bp = heap->fast[b]; bp != NULL; bp = (char *)GET_ADDR(bp)) {
+      if (!in_heap(bp) || !GET_ALLOC(HDRP(bp)) ||
+          GET_SIZE(HDRP(bp)) != (size_t)b * ALIGNMENT) {
+        printf("Error: block %p does not belong in fast bin %d\n", bp, b);
+        return;
+      }
+      bytes += GET_SIZE(HDRP(bp));
+    }
+  if (bytes != heap->fast_bytes)
+    printf("Error: fast bins hold %zu bytes, not %zu\n", bytes, heap->fast_bytes);
+}
+
+#ifdef TLSF
+// Check that the bitmaps match the lists and every block is filed right
+static void checkindex(void)
+{
+  int fl, sl, bfl, bsl;
+  char *bp;
+
+  for (fl = 0; fl < FL_COUNT; fl++) {
+    if (!(heap->fl_bitmap & (1UL << fl)) != !heap->sl_bitmap[fl])
+      printf("Error: first-level bit %d disagrees with its second level\n", fl);
+    for (sl = 0; sl < SL_COUNT; sl++) {
+      bp = ROOT_LIST(&heap->tlsf_head[fl][sl]);
+      if (!(heap->sl_bitmap[fl] & (1U << sl)) != (bp == NULL))
+        printf("Error: bitmap bit [%d][%d] disagrees with its list\n", fl, sl);
+      for ( ; bp != NULL; bp = NEXT_FREE(bp)) {
+        tlsf_mapping(GET_SIZE(HDRP(bp)), &bfl, &bsl);
+        if (GET_ALLOC(HDRP(bp)) || bfl != fl || bsl != sl)
+          printf("Error: block %p is on the wrong list [%d][%d]\n", bp, fl, sl);
+      }
+    }
+  }
+}
+#endif
+
+#ifndef TLSF
+// Check that the size tree is ordered and levelled as an AA tree, and
+// that every chain holds free blocks of its node's size
+static void checktree(char *t, size_t lo, size_t hi)
+{
+  size_t size;
+  unsigned int level;
+  char *bp;
+
+  if (t == NULL)
+    return;
+  size = GET_SIZE(HDRP(t));
+  level = LEVEL(t);
+  if (!in_heap(t) || size < TREE_MIN || size <= lo || size >= hi) {
+    printf("Error: tree node %p is out of order\n", t);
+    return;
+  }
+  if (LEVEL(LEFT(t)) + 1 != level ||
+      LEVEL(RIGHT(t)) + 1 < level || LEVEL(RIGHT(t)) > level ||
+      (RIGHT(t) != NULL && LEVEL(RIGHT(RIGHT(t))) >= level))
+    printf("Error: tree node %p breaks the level rules\n", t);
+  for (bp = t; bp != NULL; bp = NEXT_FREE(bp))
+    if (GET_ALLOC(HDRP(bp)) || GET_SIZE(HDRP(bp)) != size ||
+        (NEXT_FREE(bp) != NULL && PREV_FREE(NEXT_FREE(bp)) != bp)) {
+      printf("Error: chain of tree node %p is broken at %p\n", t, bp);
+      break;
+    }
+  checktree(LEFT(t), lo, size);
+  checktree(RIGHT(t), size, hi);
+}
+
+// Check that the address index is ordered and levelled as an AA tree,
+// and that every node is free and knows its subtree's largest size
+static void checkaddr(char *t, char *lo, char *hi)
+{
+  size_t size, max;
+  unsigned int level;
+
+  if (t == NULL)
+    return;
+  size = GET_SIZE(HDRP(t));
+  level = ALEVEL(t);
+  if (!in_heap(t) || (lo && t <= lo) || (hi && t >= hi)) {
+    printf("Error: address node %p is out of order\n", t);
+    return;
+  }
+  if (GET_ALLOC(HDRP(t)) || size < ADDR_MIN)
+    printf("Error: address node %p is not a free block of %d bytes or more\n",
+           t, ADDR_MIN);
+  if (ALEVEL(ALEFT(t)) + 1 != level ||
+      ALEVEL(ARIGHT(t)) + 1 < level || ALEVEL(ARIGHT(t)) > level ||
+      (ARIGHT(t) != NULL && ALEVEL(ARIGHT(ARIGHT(t))) >= level))
+    printf("Error: address node %p breaks the level rules\n", t);
+  max = MAX(size, MAX(AMAX(ALEFT(t)), AMAX(ARIGHT(t))));
+  if (AMAX(t) != max)
+    printf("Error: address node %p has max %zu, not %zu\n", t, AMAX(t), max);
+  checkaddr(ALEFT(t), lo, t);
+  checkaddr(ARIGHT(t), t, hi);
 }
+#endif
 
 static void printlist(void *root)
 {
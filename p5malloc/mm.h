@@ -4,8 +4,95 @@ extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
 extern void *mm_calloc (size_t nmemb, size_t size);
+
+/* Allocate size bytes whose address is a multiple of alignment, a power
+   of two. mm_posix_memalign returns 0, EINVAL or ENOMEM. */
+extern void *mm_memalign(size_t alignment, size_t size);
+extern void *mm_aligned_alloc(size_t alignment, size_t size);
+extern int mm_posix_memalign(void **memptr, size_t alignment, size_t size);
+
+/* Size-aware calls. mm_usable_size(p) is the payload p really has room
+   for; mm_free_sized(p, n) frees p, which was asked for with n bytes, as
+   mm_free does, but skips the slab lookup when n is past the slab sizes;
+   mm_good_size(n) is the payload a request of n bytes is sure to get. */
+extern size_t mm_usable_size(void *ptr);
+extern void mm_free_sized(void *ptr, size_t size);
+extern size_t mm_good_size(size_t size);
+
+/* Allocate n blocks of size bytes into out[], returning how many were
+   allocated; free n blocks at once (ptrs is sorted on the way). */
+extern size_t mm_malloc_batch(size_t size, size_t n, void **out);
+extern void mm_free_batch(void **ptrs, size_t n);
+
+/* Region arenas: objects bump-allocated from chunks of the heap with no
+   header of their own, all freed together by mm_arena_reset (which keeps
+   the chunks) or mm_arena_destroy. chunk 0 picks the default size. */
+typedef struct mm_arena mm_arena_t;
+extern mm_arena_t *mm_arena_create(size_t chunk);
+extern void *mm_arena_alloc(mm_arena_t *arena, size_t size);
+extern void mm_arena_reset(mm_arena_t *arena);
+extern void mm_arena_destroy(mm_arena_t *arena);
+
+/* Pools of fixed-size objects with no header of their own. Freed objects
+   are reused last in, first out. mm_pool_reserve makes sure n objects are
+   free; mm_pool_release gives chunks with no live objects back. */
+typedef struct mm_pool mm_pool_t;
+extern mm_pool_t *mm_pool_create(size_t obj_size, size_t align);
+extern void *mm_pool_alloc(mm_pool_t *pool);
+extern void mm_pool_free(mm_pool_t *pool, void *ptr);
+extern int mm_pool_reserve(mm_pool_t *pool, size_t n);
+extern size_t mm_pool_release(mm_pool_t *pool);
+extern void mm_pool_destroy(mm_pool_t *pool);
 extern int mm_init(void);
 
+/* Heaps of their own. mm_malloc and the rest work on the default heap;
+   mm_heap_use(h) makes the calling thread's calls work on h (the default
+   if NULL) instead and returns the heap they worked on before. A block
+   must be freed on the heap it came from. mm_heap_destroy drops a heap
+   with all its blocks. */
+typedef struct mm_heap mm_heap_t;
+extern mm_heap_t *mm_heap_create(void);
+extern void mm_heap_destroy(mm_heap_t *heap);
+extern mm_heap_t *mm_heap_use(mm_heap_t *heap);
+extern void *mm_heap_malloc(mm_heap_t *heap, size_t size);
+extern void mm_heap_free(mm_heap_t *heap, void *ptr);
+extern void *mm_heap_realloc(mm_heap_t *heap, void *ptr, size_t size);
+extern void *mm_heap_calloc(mm_heap_t *heap, size_t nmemb, size_t size);
+
+/* Tuning knobs for mm_mallopt(param, value); returns 1 on success, 0 if
+   the parameter or value is not understood. */
+#define M_SLAB           1 /* serve small requests from slab pages (1) or not (0) */
+#define M_SLAB_THRESHOLD 2 /* requests of a size class before it uses slabs */
+#define M_REALLOC_RESERVE 3 /* give steadily growing blocks headroom (1) or not (0) */
+#define M_KNOWN_ZERO     4 /* let mm_calloc skip clearing known-zero memory */
+#define M_TRIM_THRESHOLD 5 /* free bytes at the heap top before free() trims them */
+#define M_PURGE_BATCH    6 /* large free bytes to collect before purging */
+#define M_PURGE_DELAY    7 /* ms to wait between purging passes */
+#define M_MMAP_THRESHOLD 8 /* bytes from which a request gets its own mapping (0 off) */
+#define M_FAST           9 /* keep small freed blocks uncoalesced in fast bins (1) or not (0) */
+#define M_FAST_MAXSIZE  10 /* largest block size (up to 1024) that goes in a fast bin */
+#define M_FAST_CONSOLIDATE 11 /* bytes the fast bins may hold before they are merged */
+#define M_TREE          12 /* keep free blocks of 16K and up in a size tree (1) or a list (0, default) */
+#define M_ADDR_FIT      13 /* fit blocks of 64 bytes and up lowest address first (1) or not (0) */
+extern int mm_mallopt(int param, int value);
+
+/* Give free memory at the top of the heap back, keeping pad bytes of it,
+   and purge the pages inside large free blocks. Returns 1 if the heap
+   was shrunk, 0 otherwise. */
+extern int mm_trim(size_t pad);
+
+/* Counters since the last mm_init, copied out by mm_get_stats() */
+typedef struct {
+  unsigned long realloc_copies;  /* reallocs that moved the payload */
+  unsigned long copied_bytes;    /* payload bytes those moves copied */
+  unsigned long copies_avoided;  /* reallocs finished in place */
+  unsigned long avoided_bytes;   /* payload bytes those did not copy */
+  unsigned long purged_bytes;    /* free pages handed back with mem_purge */
+  unsigned long fast_hits;       /* mallocs served from a fast bin */
+  unsigned long consolidations;  /* passes that emptied the fast bins */
+} mm_stats_t;
+extern void mm_get_stats(mm_stats_t *stats);
+
 /* This is largely for debugging.  You can do what you want with the
    verbose flag; we don't care. */
 extern void mm_checkheap(int verbose);